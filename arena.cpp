@@ -0,0 +1,69 @@
+#include "arena.h"
+#include <cstring>
+
+using namespace std;
+
+// Every allocation keeps the alignment operator new gives the chunk itself
+static const size_t alignment = alignof(max_align_t);
+
+void* Arena::allocate(size_t size)
+{
+    size = (size + alignment - 1) & ~(alignment - 1);
+
+    // Move on to the next chunk that fits; a request bigger than a chunk gets one of its own
+    while (current < chunks.size() && used + size > sizes[current])
+    {
+        current++;
+        used = 0;
+    }
+    if (current == chunks.size())
+    {
+        size_t chunk = size > chunkSize ? size : chunkSize;
+        chunks.push_back(unique_ptr<char[]>(new char[chunk]));
+        sizes.push_back(chunk);
+        used = 0;
+    }
+
+    void* memory = chunks[current].get() + used;
+    used += size;
+    return memory;
+}
+
+// Function to copy length bytes of text into the arena and NUL-terminate them
+char* Arena::copy(const char* text, size_t length)
+{
+    char* memory = static_cast<char*>(allocate(length + 1));
+    memcpy(memory, text, length);
+    memory[length] = '\0';
+    return memory;
+}
+
+void Arena::rewind(const Mark& mark)
+{
+    current = mark.chunk;
+    used = mark.used;
+
+    // Back at the start, keep one ordinary chunk so one huge line does not pin memory
+    if (current == 0 && used == 0 && !chunks.empty())
+    {
+        size_t keep = sizes[0] > chunkSize ? 0 : 1;
+        chunks.resize(keep);
+        sizes.resize(keep);
+    }
+}
+
+ArenaScope::ArenaScope() : start(lineArena().mark())
+{
+}
+
+ArenaScope::~ArenaScope()
+{
+    lineArena().rewind(start);
+}
+
+// Function to get the arena of the line being executed
+Arena& lineArena()
+{
+    static Arena arena;
+    return arena;
+}
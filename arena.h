@@ -0,0 +1,50 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+// Bump allocator for the scratch data of one input line: tokenizer buffers and
+// argv arrays. Allocating only moves a pointer and nothing is freed one by one;
+// the arena is rewound when the line (or an inner scope) is done, and its chunks
+// are reused by the next line
+class Arena
+{
+public:
+    struct Mark
+    {
+        size_t chunk;
+        size_t used;
+    };
+
+    void* allocate(size_t size);
+    char* copy(const char* text, size_t length);
+    Mark mark() const { return {current, used}; }
+    void rewind(const Mark& mark);
+
+private:
+    static const size_t chunkSize = 64 * 1024;
+    vector<unique_ptr<char[]>> chunks;
+    vector<size_t> sizes;
+    size_t current = 0;
+    size_t used = 0;
+};
+
+// Rewinds the line arena to where it was when the scope began
+class ArenaScope
+{
+public:
+    ArenaScope();
+    ~ArenaScope();
+
+private:
+    Arena::Mark start;
+};
+
+// Function declarations
+Arena& lineArena();
+
+#endif // ARENA_H
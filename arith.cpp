@@ -0,0 +1,488 @@
+#include "arith.h"
+#include "shell.h"
+#include "vars.h"
+#include <iostream>
+#include <unordered_map>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <unistd.h>
+
+using namespace std;
+
+// Operators, as stored in the nodes of a parsed expression
+enum ArithOp
+{
+    OP_NONE, OP_COMMA, OP_OR, OP_AND, OP_BITOR, OP_BITXOR, OP_BITAND, OP_EQ, OP_NE,
+    OP_LT, OP_LE, OP_GT, OP_GE, OP_SHL, OP_SHR, OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD,
+    OP_POW, OP_NEG, OP_PLUS, OP_NOT, OP_BITNOT
+};
+
+enum ArithKind
+{
+    ARITH_NUMBER,      // value
+    ARITH_VARIABLE,    // name
+    ARITH_UNARY,       // op left
+    ARITH_BINARY,      // left op right; && and || only evaluate right when needed
+    ARITH_CONDITIONAL, // left ? right : third
+    ARITH_ASSIGN,      // name = right, or name op= right
+    ARITH_INCREMENT    // ++name, --name, name++ or name-- (value is the step)
+};
+
+struct ArithNode
+{
+    ArithKind kind;
+    ArithOp op;
+    long long value;
+    bool prefix;
+    string name;
+    int left, right, third; // Indexes into the expression's nodes
+};
+
+// A parsed expression. Nodes only refer to each other by index, so a cached
+// expression is one allocation that evaluates without touching the text again
+struct ArithExpression
+{
+    vector<ArithNode> nodes;
+    int root;
+};
+
+// Binary and assignment operators, longest spelling first so that "<<=" wins over "<<" and "<"
+struct OperatorSpelling
+{
+    const char* text;
+    ArithOp op;
+    int precedence; // Higher binds tighter; 2 marks an assignment
+};
+
+static const OperatorSpelling binaryOperators[] = {
+    {"<<=", OP_SHL, 2}, {">>=", OP_SHR, 2},
+    {"**", OP_POW, 14}, {"<<", OP_SHL, 11}, {">>", OP_SHR, 11}, {"<=", OP_LE, 10}, {">=", OP_GE, 10},
+    {"==", OP_EQ, 9}, {"!=", OP_NE, 9}, {"&&", OP_AND, 5}, {"||", OP_OR, 4},
+    {"+=", OP_ADD, 2}, {"-=", OP_SUB, 2}, {"*=", OP_MUL, 2}, {"/=", OP_DIV, 2}, {"%=", OP_MOD, 2},
+    {"&=", OP_BITAND, 2}, {"^=", OP_BITXOR, 2}, {"|=", OP_BITOR, 2},
+    {"*", OP_MUL, 13}, {"/", OP_DIV, 13}, {"%", OP_MOD, 13}, {"+", OP_ADD, 12}, {"-", OP_SUB, 12},
+    {"<", OP_LT, 10}, {">", OP_GT, 10}, {"&", OP_BITAND, 8}, {"^", OP_BITXOR, 7}, {"|", OP_BITOR, 6},
+    {"=", OP_NONE, 2}, {"?", OP_NONE, 3}, {",", OP_COMMA, 1},
+};
+
+// Recursive descent with precedence climbing over the source text
+class ArithParser
+{
+public:
+    ArithParser(const string& text, ArithExpression& expression) : text(text), pos(0), expression(expression) {}
+
+    bool parse(string& message)
+    {
+        skipSpaces();
+        if (pos == text.size())
+        {
+            // $(( )) is 0
+            expression.root = addNode(ARITH_NUMBER);
+            return true;
+        }
+        expression.root = parseExpression(1);
+        skipSpaces();
+        if (error.empty() && pos < text.size())
+            fail("syntax error");
+        message = error;
+        return error.empty();
+    }
+
+private:
+    const string& text;
+    size_t pos;
+    ArithExpression& expression;
+    string error;
+
+    void skipSpaces()
+    {
+        while (pos < text.size() && isspace((unsigned char)text[pos]))
+            pos++;
+    }
+
+    bool lookingAt(const char* spelling) const
+    {
+        return text.compare(pos, strlen(spelling), spelling) == 0;
+    }
+
+    int fail(const string& message)
+    {
+        if (error.empty())
+            error = message + (pos < text.size() ? " (error token is \"" + text.substr(pos) + "\")" : "");
+        pos = text.size();
+        return addNode(ARITH_NUMBER);
+    }
+
+    int addNode(ArithKind kind, ArithOp op = OP_NONE, int left = -1, int right = -1, int third = -1)
+    {
+        expression.nodes.push_back({kind, op, 0, false, string(), left, right, third});
+        return expression.nodes.size() - 1;
+    }
+
+    const OperatorSpelling* binaryOperator()
+    {
+        skipSpaces();
+        // "++" and "--" after a variable were already taken as postfix operators; anywhere
+        // else the first sign is binary and the second unary, so 2--3 is 2 - (-3)
+        for (const auto& spelling : binaryOperators)
+        {
+            if (lookingAt(spelling.text))
+                return &spelling;
+        }
+        return nullptr;
+    }
+
+    int parseExpression(int minPrecedence)
+    {
+        int left = parseUnary();
+        const OperatorSpelling* spelling;
+        while (error.empty() && (spelling = binaryOperator()) != nullptr && spelling->precedence >= minPrecedence)
+        {
+            pos += strlen(spelling->text);
+            if (spelling->precedence == 2)
+            {
+                // Assignments are right associative and need a variable on the left
+                if (expression.nodes[left].kind != ARITH_VARIABLE)
+                    return fail("attempted assignment to non-variable");
+                string name = expression.nodes[left].name;
+                int right = parseExpression(2);
+                left = addNode(ARITH_ASSIGN, spelling->op, -1, right);
+                expression.nodes[left].name = name;
+            }
+            else if (spelling->text[0] == '?')
+            {
+                int whenTrue = parseExpression(1);
+                skipSpaces();
+                if (!lookingAt(":"))
+                    return fail("expected `:' for conditional expression");
+                pos++;
+                int whenFalse = parseExpression(3);
+                left = addNode(ARITH_CONDITIONAL, OP_NONE, left, whenTrue, whenFalse);
+            }
+            else
+            {
+                // ** is right associative, everything else left
+                int right = parseExpression(spelling->op == OP_POW ? spelling->precedence : spelling->precedence + 1);
+                left = addNode(ARITH_BINARY, spelling->op, left, right);
+            }
+        }
+        return left;
+    }
+
+    // Function to check if a variable name starts at from, after any spaces; ++ and --
+    // are increments only then, otherwise --5 is two negations as in bash
+    bool variableFollows(size_t from) const
+    {
+        while (from < text.size() && isspace((unsigned char)text[from]))
+            from++;
+        return from < text.size() && (isalpha((unsigned char)text[from]) || text[from] == '_');
+    }
+
+    // Unary operators bind tighter than any binary one, so -2**2 is (-2)**2 as in bash
+    int parseUnary()
+    {
+        skipSpaces();
+        if ((lookingAt("++") || lookingAt("--")) && variableFollows(pos + 2))
+        {
+            long long step = text[pos] == '+' ? 1 : -1;
+            pos += 2;
+            int operand = parseUnary();
+            if (expression.nodes[operand].kind != ARITH_VARIABLE)
+                return fail("++ and -- need a variable");
+            int node = addNode(ARITH_INCREMENT);
+            expression.nodes[node].name = expression.nodes[operand].name;
+            expression.nodes[node].value = step;
+            expression.nodes[node].prefix = true;
+            return node;
+        }
+        if (pos < text.size() && strchr("+-!~", text[pos]) != nullptr)
+        {
+            char c = text[pos++];
+            ArithOp op = c == '-' ? OP_NEG : c == '+' ? OP_PLUS : c == '!' ? OP_NOT : OP_BITNOT;
+            int operand = parseUnary();
+            return addNode(ARITH_UNARY, op, operand);
+        }
+
+        int operand = parsePrimary();
+        skipSpaces();
+        if (expression.nodes[operand].kind == ARITH_VARIABLE && (lookingAt("++") || lookingAt("--")))
+        {
+            expression.nodes[operand].kind = ARITH_INCREMENT;
+            expression.nodes[operand].value = text[pos] == '+' ? 1 : -1;
+            pos += 2;
+        }
+        return operand;
+    }
+
+    int parsePrimary()
+    {
+        skipSpaces();
+        if (pos >= text.size())
+            return fail("syntax error: operand expected");
+
+        if (text[pos] == '(')
+        {
+            pos++;
+            int inner = parseExpression(1);
+            skipSpaces();
+            if (!lookingAt(")"))
+                return fail("missing `)'");
+            pos++;
+            return inner;
+        }
+
+        if (isdigit((unsigned char)text[pos]))
+        {
+            // Decimal, 0x hex or 0 octal, wrapping to 64 bits like C
+            const char* start = text.c_str() + pos;
+            char* end;
+            int node = addNode(ARITH_NUMBER);
+            expression.nodes[node].value = (long long)strtoull(start, &end, 0);
+            pos += end - start;
+            if (pos < text.size() && (isalnum((unsigned char)text[pos]) || text[pos] == '_'))
+                return fail("value too great for base");
+            return node;
+        }
+
+        // Variables may be written as name, $name or ${name}
+        bool braced = false;
+        if (text[pos] == '$')
+        {
+            pos++;
+            if (lookingAt("?"))
+            {
+                pos++;
+                int node = addNode(ARITH_VARIABLE);
+                expression.nodes[node].name = "?";
+                return node;
+            }
+            braced = lookingAt("{");
+            pos += braced;
+        }
+        size_t start = pos;
+        while (pos < text.size() && (isalnum((unsigned char)text[pos]) || text[pos] == '_'))
+            pos++;
+        string name = text.substr(start, pos - start);
+        if (!isValidVariableName(name))
+        {
+            pos = start;
+            return fail("syntax error: operand expected");
+        }
+        if (braced)
+        {
+            if (!lookingAt("}"))
+                return fail("bad substitution");
+            pos++;
+        }
+        int node = addNode(ARITH_VARIABLE);
+        expression.nodes[node].name = name;
+        return node;
+    }
+};
+
+static bool evaluateText(const string& text, long long& value, int depth, string& error);
+
+// Function to read a variable as a number. Unset and empty are 0; other text that is not
+// a number is evaluated as an expression itself, as bash does
+static bool variableValue(const string& name, long long& value, int depth, string& error)
+{
+    if (name == "?")
+    {
+        value = lastExitStatus;
+        return true;
+    }
+    const string* text = lookupVariable(name);
+    if (text == nullptr)
+    {
+        value = 0;
+        return true;
+    }
+    char* end;
+    value = (long long)strtoull(text->c_str(), &end, 0);
+    while (isspace((unsigned char)*end))
+        end++;
+    if (*end == '\0' && end != text->c_str() && (isdigit((unsigned char)(*text)[0]) || (*text)[0] == '-'))
+        return true;
+    if (trim(*text).empty())
+    {
+        value = 0;
+        return true;
+    }
+    if (depth >= 32)
+    {
+        error = "expression recursion level exceeded (error token is \"" + name + "\")";
+        return false;
+    }
+    return evaluateText(*text, value, depth + 1, error);
+}
+
+// Function to apply a binary operator with 64-bit two's complement wrapping; false on a bad operand
+static bool applyOperator(ArithOp op, long long a, long long b, long long& result, string& error)
+{
+    unsigned long long ua = a, ub = b;
+    switch (op)
+    {
+        case OP_COMMA:  result = b; break;
+        case OP_OR:     result = a || b; break;
+        case OP_AND:    result = a && b; break;
+        case OP_BITOR:  result = a | b; break;
+        case OP_BITXOR: result = a ^ b; break;
+        case OP_BITAND: result = a & b; break;
+        case OP_EQ:     result = a == b; break;
+        case OP_NE:     result = a != b; break;
+        case OP_LT:     result = a < b; break;
+        case OP_LE:     result = a <= b; break;
+        case OP_GT:     result = a > b; break;
+        case OP_GE:     result = a >= b; break;
+        case OP_SHL:    result = (long long)(ua << (b & 63)); break;
+        case OP_SHR:    result = a >> (b & 63); break;
+        case OP_ADD:    result = (long long)(ua + ub); break;
+        case OP_SUB:    result = (long long)(ua - ub); break;
+        case OP_MUL:    result = (long long)(ua * ub); break;
+        case OP_DIV:
+        case OP_MOD:
+            if (b == 0)
+            {
+                error = "division by 0";
+                return false;
+            }
+            // LLONG_MIN / -1 overflows, which traps on x86; wrap it instead
+            if (b == -1)
+                result = op == OP_DIV ? (long long)(0 - ua) : 0;
+            else
+                result = op == OP_DIV ? a / b : a % b;
+            break;
+        case OP_POW:
+        {
+            if (b < 0)
+            {
+                error = "exponent less than 0";
+                return false;
+            }
+            unsigned long long power = 1;
+            for (unsigned long long base = ua, exponent = b; exponent != 0; exponent >>= 1, base *= base)
+            {
+                if (exponent & 1)
+                    power *= base;
+            }
+            result = (long long)power;
+            break;
+        }
+        default:
+            result = 0;
+    }
+    return true;
+}
+
+static bool evaluateNode(const ArithExpression& expression, int index, long long& value, int depth, string& error)
+{
+    const ArithNode& node = expression.nodes[index];
+    long long left, right;
+    switch (node.kind)
+    {
+        case ARITH_NUMBER:
+            value = node.value;
+            return true;
+
+        case ARITH_VARIABLE:
+            return variableValue(node.name, value, depth, error);
+
+        case ARITH_UNARY:
+            if (!evaluateNode(expression, node.left, left, depth, error))
+                return false;
+            value = node.op == OP_NEG ? (long long)(0 - (unsigned long long)left)
+                  : node.op == OP_NOT ? !left
+                  : node.op == OP_BITNOT ? ~left : left;
+            return true;
+
+        case ARITH_BINARY:
+            if (!evaluateNode(expression, node.left, left, depth, error))
+                return false;
+            // && and || short-circuit, so 0 && 1/0 is fine
+            if ((node.op == OP_AND && !left) || (node.op == OP_OR && left))
+            {
+                value = node.op == OP_OR;
+                return true;
+            }
+            return evaluateNode(expression, node.right, right, depth, error) && applyOperator(node.op, left, right, value, error);
+
+        case ARITH_CONDITIONAL:
+            if (!evaluateNode(expression, node.left, left, depth, error))
+                return false;
+            return evaluateNode(expression, left ? node.right : node.third, value, depth, error);
+
+        case ARITH_ASSIGN:
+            if (!evaluateNode(expression, node.right, right, depth, error))
+                return false;
+            value = right;
+            if (node.op != OP_NONE && (!variableValue(node.name, left, depth, error) || !applyOperator(node.op, left, right, value, error)))
+                return false;
+            setVariable(node.name, to_string(value), false);
+            return true;
+
+        case ARITH_INCREMENT:
+            if (!variableValue(node.name, left, depth, error))
+                return false;
+            right = (long long)((unsigned long long)left + node.value);
+            setVariable(node.name, to_string(right), false);
+            value = node.prefix ? right : left;
+            return true;
+    }
+    return false;
+}
+
+// Parsed expressions by source text, so a loop body that recomputes $((i + 1)) parses it once.
+// The map never shrinks while in use: evaluating one expression can parse another (a variable
+// holding an expression), so once full, new texts are parsed without being kept
+static unordered_map<string, ArithExpression> parsedExpressions;
+static const size_t maxParsedExpressions = 4096;
+
+static bool evaluateText(const string& text, long long& value, int depth, string& error)
+{
+    auto found = parsedExpressions.find(text);
+    if (found != parsedExpressions.end())
+        return evaluateNode(found->second, found->second.root, value, depth, error);
+
+    ArithExpression expression;
+    ArithParser parser(text, expression);
+    if (!parser.parse(error))
+        return false;
+    if (parsedExpressions.size() < maxParsedExpressions)
+    {
+        const ArithExpression& stored = parsedExpressions.emplace(text, move(expression)).first->second;
+        return evaluateNode(stored, stored.root, value, depth, error);
+    }
+    return evaluateNode(expression, expression.root, value, depth, error);
+}
+
+// Function to evaluate the text of $(( )) or one `let` argument, reporting errors on stderr
+bool evaluateArithmetic(const string& text, long long& value)
+{
+    string error;
+    if (!evaluateText(text, value, 0, error))
+    {
+        cerr << trim(text) << ": " << error << endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to implement `let expr...`: the status is 0 when the last value is non-zero
+bool runLet(const vector<string>& tokens)
+{
+    if (tokens.size() < 2)
+    {
+        cerr << "let: expression expected" << endl;
+        return false;
+    }
+    long long value = 0;
+    for (size_t i = 1; i < tokens.size(); i++)
+    {
+        if (!evaluateArithmetic(tokens[i], value))
+            return false;
+    }
+    lastExitStatus = value != 0 ? 0 : 1;
+    return true;
+}
@@ -0,0 +1,13 @@
+#ifndef ARITH_H
+#define ARITH_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Function declarations
+bool evaluateArithmetic(const string& text, long long& value);
+bool runLet(const vector<string>& tokens);
+
+#endif // ARITH_H
@@ -0,0 +1,537 @@
+#include "shell.h"
+#include "history.h"
+#include "ls.h"
+#include "search.h"
+#include "complete.h"
+#include "arith.h"
+#include "vars.h"
+#include "zygote.h"
+#include <iostream>
+#include <fstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <ftw.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+// Stream buffer that throws away everything written to it
+class NullBuffer : public streambuf
+{
+protected:
+    int overflow(int c) { return c; }
+    streamsize xsputn(const char*, streamsize n) { return n; }
+};
+
+struct BenchResult
+{
+    string name;
+    string param;
+    long ops;
+    vector<double> samples; // Nanoseconds per repetition
+};
+
+static NullBuffer nullBuffer;
+static streambuf* savedCout = nullptr;
+static vector<BenchResult> results;
+static int repetitions = 5;
+
+// Function to read the monotonic clock in nanoseconds
+static double nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Silence cout while a builtin under test is running
+static void muteOutput()
+{
+    savedCout = cout.rdbuf(&nullBuffer);
+}
+
+static void unmuteOutput()
+{
+    cout.rdbuf(savedCout);
+}
+
+// Function to run a body once for warmup and then `repetitions` times
+template <typename Body>
+static void measure(const string& name, const string& param, long ops, Body body)
+{
+    BenchResult result;
+    result.name = name;
+    result.param = param;
+    result.ops = ops;
+
+    body(); // Warm caches and page in the fixture
+    for (int i = 0; i < repetitions; i++)
+    {
+        double start = nowNs();
+        body();
+        result.samples.push_back(nowNs() - start);
+    }
+    results.push_back(result);
+    cerr << "  " << name << " [" << param << "] done" << endl;
+}
+
+// Deterministic generator so every run sees the same synthetic input
+static unsigned long benchSeed = 12345;
+static unsigned long nextRandom()
+{
+    benchSeed = benchSeed * 6364136223846793005UL + 1442695040888963407UL;
+    return benchSeed >> 33;
+}
+
+// Function to build a fixed corpus of command lines mixing the shell's syntax
+static vector<string> buildCorpus(int lines)
+{
+    const char* words[] = {"ls", "-la", "grep", "\"main\"", "main.cpp", "wc", "-l", "cat",
+                           "echo", "\"Hello   World\"", "sort", "uniq", "-c", "head", "-n", "20"};
+    const int wordCount = sizeof(words) / sizeof(words[0]);
+    vector<string> corpus;
+
+    for (int i = 0; i < lines; i++)
+    {
+        string line;
+        int stages = 1 + nextRandom() % 3;
+        for (int s = 0; s < stages; s++)
+        {
+            if (s > 0)
+                line += (nextRandom() % 4 == 0) ? " ; " : " | ";
+            int count = 1 + nextRandom() % 5;
+            for (int w = 0; w < count; w++)
+            {
+                line += words[nextRandom() % wordCount];
+                line += (nextRandom() % 3 == 0) ? "   " : " ";
+            }
+        }
+        if (nextRandom() % 4 == 0)
+            line += "> out.txt";
+        corpus.push_back(line);
+    }
+    return corpus;
+}
+
+// Function to create a directory holding `count` empty files
+static void createFlatDirectory(const string& path, long count)
+{
+    mkdir(path.c_str(), 0755);
+    char name[64];
+    for (long i = 0; i < count; i++)
+    {
+        snprintf(name, sizeof(name), "/file_%07ld.txt", i);
+        int fd = open((path + name).c_str(), O_WRONLY | O_CREAT, 0644);
+        if (fd >= 0)
+            close(fd);
+    }
+}
+
+// Function to create a tree of `depth` levels with `fanout` subdirectories and `files` files each
+static long createTree(const string& path, int depth, int fanout, int files)
+{
+    mkdir(path.c_str(), 0755);
+    long created = 1;
+    for (int i = 0; i < files; i++)
+    {
+        int fd = open((path + "/leaf_" + to_string(i) + ".dat").c_str(), O_WRONLY | O_CREAT, 0644);
+        if (fd >= 0)
+            close(fd);
+        created++;
+    }
+    if (depth > 0)
+    {
+        for (int i = 0; i < fanout; i++)
+        {
+            created += createTree(path + "/dir_" + to_string(i), depth - 1, fanout, files);
+        }
+    }
+    return created;
+}
+
+static int removeEntry(const char* path, const struct stat*, int, struct FTW*)
+{
+    return remove(path);
+}
+
+static void benchTokenizers()
+{
+    vector<string> corpus = buildCorpus(20000);
+    long ops = corpus.size();
+    size_t sink = 0;
+
+    measure("tokenizeBySemicolon", "20000 lines", ops, [&]()
+    {
+        for (auto& line : corpus)
+            sink += tokenizeBySemicolon(line).size();
+    });
+    measure("tokenizeByPipe", "20000 lines", ops, [&]()
+    {
+        for (auto& line : corpus)
+            sink += tokenizeByPipe(line).size();
+    });
+    measure("tokenize", "20000 lines", ops, [&]()
+    {
+        for (auto& line : corpus)
+            sink += tokenize(line).size();
+    });
+    measure("tokenizeWithRedirection", "20000 lines", ops, [&]()
+    {
+        string inputFile, outputFile;
+        int outputMode;
+        for (auto& line : corpus)
+            sink += tokenizeWithRedirection(line, inputFile, outputFile, outputMode).size();
+    });
+
+    if (sink == 0)
+        cerr << "unexpected empty tokenization" << endl;
+}
+
+static void benchHistory()
+{
+    vector<string> corpus = buildCorpus(200);
+    long ops = corpus.size();
+
+    measure("addCommToHistory", "200 appends", ops, [&]()
+    {
+        vector<string> history;
+        for (auto& line : corpus)
+            addCommToHistory(line, history);
+    });
+    measure("loadHistory", "20 entries", 1, [&]()
+    {
+        vector<string> history;
+        loadHistory(history);
+    });
+}
+
+static void benchListing(const string& root, const vector<long>& sizes)
+{
+    for (long size : sizes)
+    {
+        string path = root + "/flat_" + to_string(size);
+        cerr << "creating " << size << " entries in " << path << endl;
+        createFlatDirectory(path, size);
+        string param = to_string(size) + " entries";
+
+        muteOutput();
+        measure("listing", param, size, [&]() { listing(path, false, false); });
+        measure("listing -la", param, size, [&]() { listing(path, true, true); });
+        measure("calculateTotalBlocks", param, size, [&]() { calculateTotalBlocks(path, true); });
+        unmuteOutput();
+
+        nftw(path.c_str(), removeEntry, 64, FTW_DEPTH | FTW_PHYS);
+    }
+}
+
+static void benchSearch(const string& root)
+{
+    struct TreeShape
+    {
+        int depth;
+        int fanout;
+        int files;
+    };
+    TreeShape shapes[] = {{3, 4, 8}, {4, 6, 10}};
+
+    for (auto& shape : shapes)
+    {
+        string path = root + "/tree";
+        long entries = createTree(path, shape.depth, shape.fanout, shape.files);
+        string param = to_string(entries) + " entries";
+
+        // Plant a unique name at the bottom of the tree so a hit still walks most of it
+        string deepestDir = path;
+        for (int d = 0; d < shape.depth; d++)
+            deepestDir += "/dir_" + to_string(shape.fanout - 1);
+        int fd = open((deepestDir + "/needle.txt").c_str(), O_WRONLY | O_CREAT, 0644);
+        if (fd >= 0)
+            close(fd);
+
+        string missing = "does_not_exist";
+        string deepest = "needle.txt";
+        measure("search miss", param, entries, [&]() { search(path, missing); });
+        measure("search hit", param, entries, [&]() { search(path, deepest); });
+
+        nftw(path.c_str(), removeEntry, 64, FTW_DEPTH | FTW_PHYS);
+    }
+}
+
+static void benchProcesses()
+{
+    startZygote();
+
+    const long launches = 200;
+    auto forkExec = [&]()
+    {
+        for (long i = 0; i < launches; i++)
+        {
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                execlp("true", "true", (char*)nullptr);
+                _exit(127);
+            }
+            waitpid(pid, nullptr, 0);
+        }
+    };
+    vector<string> trueCommand = {"true"};
+    auto zygote = [&]()
+    {
+        for (long i = 0; i < launches; i++)
+        {
+            pid_t pid = zygoteSpawn(trueCommand, -1, -1, -1);
+            if (pid > 0)
+                waitpid(pid, nullptr, 0);
+        }
+    };
+    measure("fork/exec", "true", launches, forkExec);
+    measure("zygoteSpawn", "true", launches, zygote);
+
+    // A fork copies the page tables of everything the shell has touched; the zygote stays small
+    {
+        vector<char> heap(256 << 20, 1);
+        measure("fork/exec", "true with 256 MiB heap", launches, forkExec);
+        measure("zygoteSpawn", "true with 256 MiB heap", launches, zygote);
+    }
+
+    string baseDir = ".";
+    string currentDir = ".";
+    vector<string> history;
+    int status = 1;
+    int stageCounts[] = {2, 4, 8};
+    for (int stages : stageCounts)
+    {
+        vector<vector<string>> commands;
+        commands.push_back({"true"});
+        for (int s = 1; s < stages; s++)
+            commands.push_back({"cat"});
+
+        const long runs = 50;
+        measure("executePipeline", to_string(stages) + " stages", runs, [&]()
+        {
+            for (long i = 0; i < runs; i++)
+                executePipeline(commands, baseDir, currentDir, history, status);
+        });
+    }
+}
+
+static void benchArithmetic()
+{
+    // A loop body: the same texts over and over, so every evaluation after the first is a cache hit
+    const long evaluations = 100000;
+    long long value = 0;
+    setVariable("i", "0", false);
+    measure("evaluateArithmetic", "i = i + 1", evaluations, [&]()
+    {
+        for (long n = 0; n < evaluations; n++)
+            evaluateArithmetic("i = i + 1", value);
+    });
+    measure("evaluateArithmetic", "(i * 31 + 7) % 1000 < 500 ? i << 2 : i >> 1", evaluations, [&]()
+    {
+        for (long n = 0; n < evaluations; n++)
+            evaluateArithmetic("(i * 31 + 7) % 1000 < 500 ? i << 2 : i >> 1", value);
+    });
+    unsetVariable("i");
+
+    if (value == -1)
+        cerr << "unexpected arithmetic result" << endl;
+}
+
+static void benchCompletion(const string& root)
+{
+    // A PATH directory with thousands of executables, like a busy /usr/bin
+    string binDir = root + "/bin";
+    mkdir(binDir.c_str(), 0755);
+    const long executables = 5000;
+    char name[64];
+    for (long i = 0; i < executables; i++)
+    {
+        snprintf(name, sizeof(name), "/tool%05ld", i);
+        int fd = open((binDir + name).c_str(), O_WRONLY | O_CREAT, 0755);
+        if (fd >= 0)
+            close(fd);
+    }
+    const char* oldPath = getenv("PATH");
+    string savedPath = oldPath ? oldPath : "";
+    setenv("PATH", (binDir + ":" + savedPath).c_str(), 1);
+
+    size_t sink = 0;
+    const long lookups = 1000;
+    measure("completeCommand", to_string(executables) + " executables", lookups, [&]()
+    {
+        for (long i = 0; i < lookups; i++)
+            sink += completeCommand(i % 2 ? "tool012" : "ca").size();
+    });
+    measure("completePath", "flat dir", lookups, [&]()
+    {
+        for (long i = 0; i < lookups; i++)
+            sink += completePath(binDir + "/tool0001").size();
+    });
+
+    setenv("PATH", savedPath.c_str(), 1);
+    nftw(binDir.c_str(), removeEntry, 64, FTW_DEPTH | FTW_PHYS);
+    if (sink == 0)
+        cerr << "unexpected empty completion" << endl;
+}
+
+static double median(vector<double> samples)
+{
+    sort(samples.begin(), samples.end());
+    size_t mid = samples.size() / 2;
+    if (samples.size() % 2 == 0)
+        return (samples[mid - 1] + samples[mid]) / 2;
+    return samples[mid];
+}
+
+// Function to write every result as CSV or JSON
+static void report(ostream& out, const string& format)
+{
+    if (format == "json")
+        out << "[" << endl;
+    else
+        out << "benchmark,param,ops,reps,min_ns_per_op,median_ns_per_op,max_ns_per_op,ops_per_sec" << endl;
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult& r = results[i];
+        double lo = *min_element(r.samples.begin(), r.samples.end()) / r.ops;
+        double hi = *max_element(r.samples.begin(), r.samples.end()) / r.ops;
+        double mid = median(r.samples) / r.ops;
+        double rate = mid > 0 ? 1e9 / mid : 0;
+
+        char line[512];
+        if (format == "json")
+        {
+            snprintf(line, sizeof(line),
+                     "  {\"benchmark\": \"%s\", \"param\": \"%s\", \"ops\": %ld, \"reps\": %zu, "
+                     "\"min_ns_per_op\": %.1f, \"median_ns_per_op\": %.1f, \"max_ns_per_op\": %.1f, \"ops_per_sec\": %.1f}%s",
+                     r.name.c_str(), r.param.c_str(), r.ops, r.samples.size(), lo, mid, hi, rate,
+                     i + 1 < results.size() ? "," : "");
+        }
+        else
+        {
+            snprintf(line, sizeof(line), "%s,%s,%ld,%zu,%.1f,%.1f,%.1f,%.1f",
+                     r.name.c_str(), r.param.c_str(), r.ops, r.samples.size(), lo, mid, hi, rate);
+        }
+        out << line << endl;
+    }
+
+    if (format == "json")
+        out << "]" << endl;
+}
+
+static vector<long> parseSizes(const string& list)
+{
+    vector<long> sizes;
+    stringstream ss(list);
+    string item;
+    while (getline(ss, item, ','))
+    {
+        if (!item.empty())
+            sizes.push_back(atol(item.c_str()));
+    }
+    return sizes;
+}
+
+static void usage()
+{
+    cerr << "usage: ccbench [-r reps] [-f csv|json] [-o file] [-s sizes] [-g groups]" << endl;
+    cerr << "  sizes   comma separated directory sizes for listing (default 1000,100000,1000000)" << endl;
+    cerr << "  groups  comma separated subset of tokenize,history,listing,search,process,complete,arith" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    string format = "csv";
+    string outputPath;
+    string groups = "tokenize,history,listing,search,process,complete,arith";
+    vector<long> sizes = {1000, 100000, 1000000};
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:f:o:s:g:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'r': repetitions = max(1, atoi(optarg)); break;
+            case 'f': format = optarg; break;
+            case 'o': outputPath = optarg; break;
+            case 's': sizes = parseSizes(optarg); break;
+            case 'g': groups = optarg; break;
+            default: usage(); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (format != "csv" && format != "json")
+    {
+        usage();
+        return 1;
+    }
+
+    // Run inside a scratch directory so history.txt and fixtures never touch the tree
+    char originalDir[PATH_MAX];
+    if (getcwd(originalDir, sizeof(originalDir)) == nullptr)
+    {
+        perror("getcwd");
+        return 1;
+    }
+    const char* tmp = getenv("TMPDIR");
+    string scratchTemplate = string(tmp ? tmp : "/tmp") + "/ccbench.XXXXXX";
+    vector<char> scratch(scratchTemplate.begin(), scratchTemplate.end());
+    scratch.push_back('\0');
+    if (mkdtemp(scratch.data()) == nullptr || chdir(scratch.data()) != 0)
+    {
+        perror("scratch directory");
+        return 1;
+    }
+    string root = scratch.data();
+
+    vector<string> selected;
+    stringstream ss(groups);
+    string group;
+    while (getline(ss, group, ','))
+        selected.push_back(group);
+    auto wanted = [&](const string& name)
+    {
+        return find(selected.begin(), selected.end(), name) != selected.end();
+    };
+
+    if (wanted("tokenize"))
+        benchTokenizers();
+    if (wanted("history"))
+        benchHistory();
+    if (wanted("listing"))
+        benchListing(root, sizes);
+    if (wanted("search"))
+        benchSearch(root);
+    if (wanted("process"))
+        benchProcesses();
+    if (wanted("complete"))
+        benchCompletion(root);
+    if (wanted("arith"))
+        benchArithmetic();
+
+    if (chdir(originalDir) != 0)
+        perror("chdir");
+    nftw(root.c_str(), removeEntry, 64, FTW_DEPTH | FTW_PHYS);
+
+    if (outputPath.empty())
+    {
+        report(cout, format);
+    }
+    else
+    {
+        ofstream out(outputPath);
+        report(out, format);
+    }
+    return 0;
+}
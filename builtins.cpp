@@ -0,0 +1,385 @@
+#include "builtins.h"
+#include "shell.h"
+#include "cd.h"
+#include "echo.h"
+#include "pwd.h"
+#include "history.h"
+#include "search.h"
+#include "ls.h"
+#include "pinfo.h"
+#include "parallel.h"
+#include "vars.h"
+#include "ptop.h"
+#include "prompt.h"
+#include "jump.h"
+#include "plugin.h"
+#include "cache.h"
+#include "watch.h"
+#include "pin.h"
+#include "limit.h"
+#include "arith.h"
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+static bool builtinCd(vector<string>& tokens, BuiltinContext& context)
+{
+    string path;
+
+    if (tokens.size() == 1) 
+    {
+        // No arguments provided, go to baseDir
+        path = context.baseDir;
+    } 
+    else if (tokens.size() >= 3 && tokens[1] == "-j") 
+    {
+        // cd -j query...: jump to the best frecency match
+        vector<string> query(tokens.begin() + 1, tokens.end());
+        query[0] = "z";
+        return runJump(query);
+    }
+    else if (tokens.size() == 2) 
+    {
+        path = tokens[1];
+
+        if (path == "~") 
+        {
+            path = context.baseDir;
+        }
+    } 
+    else 
+    {
+        cerr << "cd: too many arguments" << endl;
+        return false;
+    }
+
+    if (changeDirectory(path, previousDir)) 
+    {
+        promptDirectoryChanged(); // The only place the shell's cwd changes
+        return true;
+    }
+
+    return false;
+}
+
+static bool builtinEcho(vector<string>& tokens, BuiltinContext& context)
+{
+    echoPrinting(tokens);
+    return true;
+}
+
+static bool builtinPwd(vector<string>& tokens, BuiltinContext& context)
+{
+    PresentWorkingDirectory(context.baseDir);
+    return true;
+}
+
+static bool builtinLs(vector<string>& tokens, BuiltinContext& context)
+{
+    bool all = false;
+    bool longformat = false;
+    string path = context.currentDir;
+
+    vector<string> paths;
+    for (long unsigned int i = 1; i < tokens.size(); i++) 
+    {
+        if (tokens[i] == "-a")
+            all = true;
+        else if (tokens[i] == "-l")
+            longformat = true;
+        else if (tokens[i] == "-la" || tokens[i] == "-al") 
+        {
+            all = true;
+            longformat = true;
+        }
+        else if (tokens[i].front() != '-') 
+        {
+            path = tokens[i];
+            if (path == "~") 
+            {
+                path = context.baseDir;
+            }
+            paths.push_back(path);
+        }
+    }
+
+    if (paths.size() > 1) 
+    {
+        // File operands, as from `ls *.log`, come first and together, then each directory
+        vector<string> directories;
+        bool ok = true;
+        for (auto& path : paths) 
+        {
+            struct stat info;
+            if (stat(path.c_str(), &info) == 0 && !S_ISDIR(info.st_mode)) 
+                ok = listing(path, all, longformat) && ok;
+            else 
+                directories.push_back(path);
+        }
+        for (size_t i = 0; i < directories.size(); i++) 
+        {
+            if (i > 0 || directories.size() < paths.size()) 
+                cout << endl;
+            cout << directories[i] << ": " << endl;
+            ok = listing(directories[i], all, longformat) && ok;
+        }
+        return ok;
+    } 
+    else 
+    {
+        if (path == "~") 
+        {
+            path = context.baseDir;
+        }
+
+        struct stat info;
+        if (longformat && stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode)) 
+        {
+            // Calculate total block size before listing
+            long totalBlocks = calculateTotalBlocks(path, all);
+            cout << "total " << totalBlocks << endl;
+        }
+
+        return listing(path, all, longformat);
+    }
+}
+
+static bool builtinPinfo(vector<string>& tokens, BuiltinContext& context)
+{
+    // Check for the tree flag and whether a PID is provided
+    bool tree = false;
+    int pid = getpid(); // Use the shell's own PID if no PID is provided
+    for (long unsigned int i = 1; i < tokens.size(); i++) 
+    {
+        if (tokens[i] == "-t") 
+        {
+            tree = true;
+        }
+        else 
+        {
+            pid = atoi(tokens[i].c_str());
+            if (pid <= 0) 
+            {
+                cerr << "pinfo: invalid pid " << tokens[i] << endl;
+                return false;
+            }
+        }
+    }
+
+    // Call the pinfo function with the specified PID
+    if (tree)
+        pinfoTree(pid);
+    else
+        pinfo(pid);
+    return true;
+}
+
+static bool builtinSearch(vector<string>& tokens, BuiltinContext& context)
+{
+    if (tokens.size() != 2) 
+    {
+        cerr << "search: missing argument" << endl;
+        return false;
+    }
+    string target = tokens[1];
+
+    if(search(context.currentDir, target) == true)
+        cout << "True" << endl;
+    else
+        cout << "False" << endl;
+    
+    return true;
+}
+
+static bool builtinHistory(vector<string>& tokens, BuiltinContext& context)
+{
+    if(tokens.size() == 1)
+    {
+        displayHistory(context.history, 0);
+    }
+    else
+    {
+        displayHistory(context.history, stoi(tokens[1]));
+    }
+    return true;
+}
+
+static bool builtinExit(vector<string>& tokens, BuiltinContext& context)
+{
+    context.status = 0;
+    return true;
+}
+
+// Builtins implemented in their own files take only the tokens
+static bool builtinParallel(vector<string>& tokens, BuiltinContext& context) { return runParallel(tokens); }
+static bool builtinPtop(vector<string>& tokens, BuiltinContext& context) { return runPtop(tokens); }
+static bool builtinExport(vector<string>& tokens, BuiltinContext& context) { return runExport(tokens); }
+static bool builtinUnset(vector<string>& tokens, BuiltinContext& context) { return runUnset(tokens); }
+static bool builtinJump(vector<string>& tokens, BuiltinContext& context) { return runJump(tokens); }
+static bool builtinPushd(vector<string>& tokens, BuiltinContext& context) { return runPushd(tokens); }
+static bool builtinPopd(vector<string>& tokens, BuiltinContext& context) { return runPopd(tokens); }
+static bool builtinDirs(vector<string>& tokens, BuiltinContext& context) { return runDirs(tokens); }
+static bool builtinEnable(vector<string>& tokens, BuiltinContext& context) { return runEnable(tokens); }
+static bool builtinCache(vector<string>& tokens, BuiltinContext& context) { return runCache(tokens, context); }
+static bool builtinUlimit(vector<string>& tokens, BuiltinContext& context) { return runUlimit(tokens); }
+static bool builtinLet(vector<string>& tokens, BuiltinContext& context) { return runLet(tokens); }
+
+// The one list of builtins; every executor, completion and $(...) capture read it
+static constexpr Builtin builtins[] = {
+    {"cd",       builtinCd,       BUILTIN_PARENT},
+    {"echo",     builtinEcho,     BUILTIN_PIPELINE | BUILTIN_CAPTURE},
+    {"pwd",      builtinPwd,      BUILTIN_PIPELINE | BUILTIN_CAPTURE},
+    {"ls",       builtinLs,       BUILTIN_PIPELINE | BUILTIN_CAPTURE},
+    {"pinfo",    builtinPinfo,    BUILTIN_PIPELINE | BUILTIN_CAPTURE},
+    {"search",   builtinSearch,   BUILTIN_PIPELINE | BUILTIN_CAPTURE},
+    {"history",  builtinHistory,  BUILTIN_PIPELINE | BUILTIN_CAPTURE},
+    {"parallel", builtinParallel, BUILTIN_PIPELINE},
+    {"ptop",     builtinPtop,     BUILTIN_PIPELINE},
+    {"export",   builtinExport,   BUILTIN_PARENT},
+    {"unset",    builtinUnset,    BUILTIN_PARENT},
+    {"z",        builtinJump,     BUILTIN_PARENT},
+    {"pushd",    builtinPushd,    BUILTIN_PARENT},
+    {"popd",     builtinPopd,     BUILTIN_PARENT},
+    {"dirs",     builtinDirs,     BUILTIN_PIPELINE | BUILTIN_CAPTURE},
+    {"enable",   builtinEnable,   BUILTIN_PARENT},
+    {"cache",    builtinCache,    BUILTIN_PIPELINE},
+    {"on-change", runOnChange,    BUILTIN_PIPELINE},
+    {"watch",    runWatch,        BUILTIN_PIPELINE},
+    {"pin",      runPin,          BUILTIN_PIPELINE},
+    {"ulimit",   builtinUlimit,   BUILTIN_PARENT | BUILTIN_PIPELINE},
+    {"limit",    runLimit,        BUILTIN_PIPELINE},
+    {"let",      builtinLet,      BUILTIN_PARENT},
+    {"exit",     builtinExit,     BUILTIN_PARENT},
+};
+static constexpr size_t builtinCount = sizeof(builtins) / sizeof(builtins[0]);
+
+// Names hash straight to a slot. The seed is chosen so that no two builtins
+// share one; if the static_assert below fires after adding a builtin, try
+// other seeds (or more slots) until it passes
+static constexpr uint32_t builtinSeed = 4;
+static constexpr size_t slotCount = 128;
+
+static constexpr uint32_t builtinHash(const char* name, uint32_t hash = builtinSeed)
+{
+    return *name == '\0' ? hash ^ (hash >> 16) : builtinHash(name + 1, (hash ^ (unsigned char)*name) * 16777619u);
+}
+
+static constexpr size_t slotOf(const char* name)
+{
+    return builtinHash(name) & (slotCount - 1);
+}
+
+// The same hash as a loop, for lookups at run time: the recursive form is only for the
+// compiler, and a long command word would overflow the stack in an unoptimized build
+static size_t slotOfWord(const string& name)
+{
+    uint32_t hash = builtinSeed;
+    for (unsigned char c : name)
+        hash = (hash ^ c) * 16777619u;
+    return (hash ^ (hash >> 16)) & (slotCount - 1);
+}
+
+static constexpr bool slotTakenBefore(size_t slot, size_t before, size_t i = 0)
+{
+    return i < before && (slotOf(builtins[i].name) == slot || slotTakenBefore(slot, before, i + 1));
+}
+
+static constexpr bool slotsUnique(size_t i = 0)
+{
+    return i == builtinCount || (!slotTakenBefore(slotOf(builtins[i].name), i) && slotsUnique(i + 1));
+}
+
+static_assert(slotsUnique(), "builtin names collide in the dispatch table; change builtinSeed");
+static_assert(builtinCount < slotCount && builtinCount < 128, "too many builtins for the dispatch table");
+
+struct SlotTable
+{
+    signed char index[slotCount];
+
+    SlotTable()
+    {
+        memset(index, -1, sizeof(index));
+        for (size_t i = 0; i < builtinCount; i++)
+            index[slotOf(builtins[i].name)] = (signed char)i;
+    }
+};
+
+// Function to find a builtin with one hash and one string compare, then among loaded plugins
+const Builtin* findBuiltin(const string& name)
+{
+    static const SlotTable table;
+    int i = table.index[slotOfWord(name)];
+    if (i < 0 || name != builtins[i].name)
+        return findPlugin(name);
+    return &builtins[i];
+}
+
+const Builtin* listBuiltins(size_t& count)
+{
+    count = builtinCount;
+    return builtins;
+}
+
+// Function to run a builtin with stdin/stdout redirected, restoring both afterwards.
+// Works in the shell itself, so cd or export with a redirection still take effect
+bool runBuiltinRedirected(const Builtin* builtin, vector<string>& tokens, BuiltinContext& context, const string& inputFile, const string& outputFile, int outputMode)
+{
+    int inputFd = -1;
+    int outputFd = -1;
+    if (!inputFile.empty()) 
+    {
+        inputFd = open(inputFile.c_str(), O_RDONLY | O_CLOEXEC);
+        if (inputFd < 0) 
+        {
+            cerr << "Error: Cannot open input file." << endl;
+            return false;
+        }
+    }
+    if (!outputFile.empty()) 
+    {
+        outputFd = open(outputFile.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | outputMode, 0644);
+        if (outputFd < 0) 
+        {
+            cerr << "Error: Cannot open output file." << endl;
+            if (inputFd >= 0)
+                close(inputFd);
+            return false;
+        }
+    }
+
+    cout.flush();
+    int savedInput = -1;
+    int savedOutput = -1;
+    if (inputFd >= 0) 
+    {
+        savedInput = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 10);
+        dup2(inputFd, STDIN_FILENO);
+        close(inputFd);
+    }
+    if (outputFd >= 0) 
+    {
+        savedOutput = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 10);
+        dup2(outputFd, STDOUT_FILENO);
+        close(outputFd);
+    }
+
+    bool ok = builtin->handler(tokens, context);
+    cout.flush();
+
+    if (savedOutput >= 0) 
+    {
+        dup2(savedOutput, STDOUT_FILENO);
+        close(savedOutput);
+    }
+    if (savedInput >= 0) 
+    {
+        dup2(savedInput, STDIN_FILENO);
+        close(savedInput);
+    }
+    return ok;
+}
@@ -0,0 +1,38 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Shell state a builtin may read or change
+struct BuiltinContext
+{
+    string& baseDir;
+    string& currentDir;
+    const string& input; // The command line after substitution, for builtins that parse it themselves
+    vector<string>& history;
+    int& status;         // Set to 0 to leave the shell loop
+};
+
+typedef bool (*BuiltinHandler)(vector<string>& tokens, BuiltinContext& context);
+
+// Builtin flags
+const unsigned BUILTIN_PARENT = 1;    // Changes shell state, so it runs in the shell process itself
+const unsigned BUILTIN_PIPELINE = 2;  // Can be a pipeline stage; runs in that stage's child
+const unsigned BUILTIN_CAPTURE = 4;   // Only writes to cout, so $(...) can capture it without forking
+
+struct Builtin
+{
+    const char* name;
+    BuiltinHandler handler;
+    unsigned flags;
+};
+
+// Function declarations
+const Builtin* findBuiltin(const string& name);
+const Builtin* listBuiltins(size_t& count);
+bool runBuiltinRedirected(const Builtin* builtin, vector<string>& tokens, BuiltinContext& context, const string& inputFile, const string& outputFile, int outputMode);
+
+#endif // BUILTINS_H
@@ -0,0 +1,409 @@
+#include "cache.h"
+#include "shell.h"
+#include "vars.h"
+#include "builtins.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <cerrno>
+#include <ctime>
+#include <climits>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+// One file per result, named by the key's hash:
+//   magic | created (u64) | status (i32) | key length, stdout length, stderr length (u64 each)
+//   | key | stdout | stderr
+// The key text is stored too, so a hash collision reads as a miss
+static const char cacheMagic[8] = {'C', 'C', 'C', 'A', 'C', 'H', 'E', '1'};
+
+struct CacheHeader
+{
+    char magic[8];
+    uint64_t created;
+    int32_t status;
+    uint32_t reserved;
+    uint64_t keyLength;
+    uint64_t outLength;
+    uint64_t errLength;
+};
+
+// Results larger than this are still shown, just not stored
+static const size_t maxCachedBytes = 64 << 20;
+
+// How long a result of a $CACHE_COMMANDS command is replayed unless $CACHE_TTL says otherwise
+static const long defaultAutoTtl = 10 * 60;
+
+// Function to find the store: $CACHE_DIR, else ~/.cache/cc
+static string cacheDirectory()
+{
+    const string* dir = lookupVariable("CACHE_DIR");
+    if (dir != nullptr && !dir->empty())
+        return *dir;
+    const string* home = lookupVariable("HOME");
+    return (home != nullptr ? *home : string(".")) + "/.cache/cc";
+}
+
+static bool makeDirectories(const string& path)
+{
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1))
+    {
+        string prefix = path.substr(0, slash);
+        if (mkdir(prefix.c_str(), 0700) != 0 && errno != EEXIST)
+            return false;
+        if (slash == string::npos)
+            return true;
+    }
+}
+
+static uint64_t fnv1a(const string& data)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : data)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Function to build the key: argv, the cwd, the exported environment (LANG, PATH and the
+// like change what a command prints), and each dependency's identity and version
+static string cacheKey(const vector<string>& command, const vector<string>& deps)
+{
+    string key;
+    char cwd[PATH_MAX];
+    key += getcwd(cwd, sizeof(cwd)) != nullptr ? cwd : "?";
+    key += '\0';
+    for (const string& arg : command)
+    {
+        key += arg;
+        key += '\0';
+    }
+
+    // Sorted, so the same variables give the same key whatever order they were set in
+    vector<string> environment;
+    for (char** entry = exportedEnvironment(); *entry != nullptr; entry++)
+        environment.push_back(*entry);
+    sort(environment.begin(), environment.end());
+    for (const string& entry : environment)
+    {
+        key += '\0';
+        key += entry;
+    }
+    key += '\0';
+    for (const string& dep : deps)
+    {
+        struct stat info;
+        key += '\0';
+        key += dep;
+        if (stat(dep.c_str(), &info) == 0)
+        {
+            key += ':' + to_string(info.st_dev) + ':' + to_string(info.st_ino) + ':' + to_string(info.st_size) + ':' +
+                   to_string(info.st_mtim.tv_sec) + '.' + to_string(info.st_mtim.tv_nsec);
+        }
+        else
+        {
+            key += ":missing";
+        }
+    }
+    return key;
+}
+
+static void writeAll(int fd, const char* data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        data += written;
+        length -= written;
+    }
+}
+
+// Function to replay a stored result; false on a miss, an expired entry or a damaged file
+static bool replayEntry(const string& path, const string& key, long ttlSeconds)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(CacheHeader))
+    {
+        close(fd);
+        return false;
+    }
+    size_t size = info.st_size;
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return false;
+
+    const char* data = (const char*)mapped;
+    CacheHeader header;
+    memcpy(&header, data, sizeof(header));
+    bool valid = memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0 &&
+                 sizeof(header) + header.keyLength + header.outLength + header.errLength == size &&
+                 header.keyLength == key.size() && memcmp(data + sizeof(header), key.data(), key.size()) == 0;
+    if (valid && ttlSeconds >= 0 && (uint64_t)time(nullptr) - header.created > (uint64_t)ttlSeconds)
+        valid = false;
+
+    if (valid)
+    {
+        const char* out = data + sizeof(header) + header.keyLength;
+        writeAll(STDOUT_FILENO, out, header.outLength);
+        writeAll(STDERR_FILENO, out + header.outLength, header.errLength);
+        lastExitStatus = header.status;
+    }
+    munmap(mapped, size);
+    return valid;
+}
+
+// Function to store a result through a temporary file and rename, so readers never see half of it
+static void storeEntry(const string& path, const string& key, int status, const string& out, const string& err)
+{
+    CacheHeader header = {};
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.created = time(nullptr);
+    header.status = status;
+    header.keyLength = key.size();
+    header.outLength = out.size();
+    header.errLength = err.size();
+
+    string temp = path + "." + to_string(getpid());
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return;
+    writeAll(fd, (const char*)&header, sizeof(header));
+    writeAll(fd, key.data(), key.size());
+    writeAll(fd, out.data(), out.size());
+    writeAll(fd, err.data(), err.size());
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(temp.c_str(), path.c_str()) != 0)
+        unlink(temp.c_str());
+}
+
+// Function to run a command with stdout and stderr teed into buffers; returns its wait status.
+// A builtin gets the caller's context, so it sees the shell's directories and history
+static int runAndCapture(const vector<string>& command, string& out, string& err, bool& complete, BuiltinContext& context)
+{
+    int outPipe[2], errPipe[2];
+    if (pipe2(outPipe, O_CLOEXEC) < 0)
+    {
+        perror("cache: pipe");
+        return -1;
+    }
+    if (pipe2(errPipe, O_CLOEXEC) < 0)
+    {
+        perror("cache: pipe");
+        close(outPipe[0]);
+        close(outPipe[1]);
+        return -1;
+    }
+
+    cout.flush();
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror("cache: fork");
+        for (int fd : {outPipe[0], outPipe[1], errPipe[0], errPipe[1]})
+            close(fd);
+        return -1;
+    }
+    if (pid == 0)
+    {
+        dup2(outPipe[1], STDOUT_FILENO);
+        dup2(errPipe[1], STDERR_FILENO);
+
+        // A builtin runs right here; anything else is exec'd
+        vector<string> words = command;
+        _exit(runWords(words, context));
+    }
+    close(outPipe[1]);
+    close(errPipe[1]);
+
+    // Show the output live while keeping a copy
+    complete = true;
+    pollfd fds[2] = {{outPipe[0], POLLIN, 0}, {errPipe[0], POLLIN, 0}};
+    string* buffers[2] = {&out, &err};
+    int targets[2] = {STDOUT_FILENO, STDERR_FILENO};
+    int openPipes = 2;
+    char chunk[65536];
+    while (openPipes > 0)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        for (int i = 0; i < 2; i++)
+        {
+            if (fds[i].fd < 0 || fds[i].revents == 0)
+                continue;
+            ssize_t count = read(fds[i].fd, chunk, sizeof(chunk));
+            if (count < 0 && errno == EINTR)
+                continue;
+            if (count <= 0)
+            {
+                close(fds[i].fd);
+                fds[i].fd = -1;
+                openPipes--;
+                continue;
+            }
+            writeAll(targets[i], chunk, count);
+            if (out.size() + err.size() + count > maxCachedBytes)
+                complete = false;
+            else if (complete)
+                buffers[i]->append(chunk, count);
+        }
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+        ;
+    return status;
+}
+
+// Function to check if stdin carries data for the command: a pipe or a file, not a terminal
+// or /dev/null. The key cannot tell one input from another, so such a run is not cached
+static bool stdinIsData()
+{
+    struct stat input, devNull;
+    if (isatty(STDIN_FILENO) || fstat(STDIN_FILENO, &input) != 0)
+        return false;
+    return !(stat("/dev/null", &devNull) == 0 && S_ISCHR(input.st_mode) && input.st_rdev == devNull.st_rdev);
+}
+
+// Function to replay a cached result of the command, or run it and store the result
+bool runCachedCommand(const vector<string>& command, long ttlSeconds, const vector<string>& deps, BuiltinContext& context)
+{
+    string dir = cacheDirectory();
+    string key = cacheKey(command, deps);
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long)fnv1a(key));
+    string path = dir + "/" + name;
+
+    bool cacheable = !stdinIsData();
+    if (cacheable && replayEntry(path, key, ttlSeconds))
+        return true;
+
+    string out, err;
+    bool complete;
+    int status = runAndCapture(command, out, err, complete, context);
+    if (status == -1)
+        return false;
+    if (!WIFEXITED(status))
+    {
+        // Interrupted or crashed: nothing worth remembering
+        lastExitStatus = 128 + WTERMSIG(status);
+        return true;
+    }
+    lastExitStatus = WEXITSTATUS(status);
+    if (cacheable && complete && makeDirectories(dir))
+        storeEntry(path, key, lastExitStatus, out, err);
+    return true;
+}
+
+// Function to check $CACHE_COMMANDS, the external commands that are cached without asking
+bool isAutoCached(const string& command)
+{
+    const string* list = lookupVariable("CACHE_COMMANDS");
+    if (list == nullptr || list->empty())
+        return false;
+    string padded = " " + *list + " ";
+    return padded.find(" " + command + " ") != string::npos;
+}
+
+// Function to parse a duration such as 30, 30s, 5m, 2h or 1d into seconds
+static long parseDuration(const string& text)
+{
+    char* end;
+    long value = strtol(text.c_str(), &end, 10);
+    if (end == text.c_str() || value < 0)
+        return -1;
+    switch (*end)
+    {
+        case '\0':
+        case 's': return value;
+        case 'm': return value * 60;
+        case 'h': return value * 3600;
+        case 'd': return value * 86400;
+        default: return -1;
+    }
+}
+
+// Function to find how long results of $CACHE_COMMANDS commands are replayed: $CACHE_TTL, else 10 minutes
+long autoCacheTtl()
+{
+    const string* text = lookupVariable("CACHE_TTL");
+    long ttl = text != nullptr ? parseDuration(*text) : -1;
+    return ttl >= 0 ? ttl : defaultAutoTtl;
+}
+
+// Function to implement `cache [--ttl T] [--dep file...] -- cmd` and `cache --clear`
+bool runCache(const vector<string>& tokens, BuiltinContext& context)
+{
+    long ttl = -1;
+    vector<string> deps;
+    size_t i = 1;
+    for (; i < tokens.size() && tokens[i] != "--"; i++)
+    {
+        if (tokens[i] == "--ttl" && i + 1 < tokens.size())
+        {
+            ttl = parseDuration(tokens[++i]);
+            if (ttl < 0)
+            {
+                cerr << "cache: bad duration " << tokens[i] << endl;
+                return false;
+            }
+        }
+        else if (tokens[i] == "--dep")
+        {
+            // Every word up to the next option is a dependency
+            while (i + 1 < tokens.size() && tokens[i + 1].compare(0, 2, "--") != 0)
+                deps.push_back(tokens[++i]);
+        }
+        else if (tokens[i] == "--clear" && tokens.size() == 2)
+        {
+            string dir = cacheDirectory();
+            DIR* handle = opendir(dir.c_str());
+            if (handle == nullptr)
+                return true;
+            while (dirent* entry = readdir(handle))
+            {
+                if (entry->d_name[0] != '.')
+                    unlink((dir + "/" + entry->d_name).c_str());
+            }
+            closedir(handle);
+            return true;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (i >= tokens.size() || tokens[i] != "--" || i + 1 == tokens.size())
+    {
+        cerr << "cache: usage: cache [--ttl T] [--dep file...] -- command [args...]" << endl;
+        return false;
+    }
+    vector<string> command(tokens.begin() + i + 1, tokens.end());
+    return runCachedCommand(command, ttl, deps, context);
+}
@@ -0,0 +1,16 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "builtins.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Function declarations
+bool isAutoCached(const string& command);
+long autoCacheTtl();
+bool runCachedCommand(const vector<string>& command, long ttlSeconds, const vector<string>& deps, BuiltinContext& context);
+bool runCache(const vector<string>& tokens, BuiltinContext& context);
+
+#endif // CACHE_H
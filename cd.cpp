@@ -1,4 +1,5 @@
 #include "cd.h"
+#include "jump.h"
 #include <unistd.h>
 #include <iostream>
 #include <limits.h>
@@ -46,5 +47,6 @@ bool changeDirectory(const string& path, string& previousDir)
     }
 
     previousDir = currentDir;
+    recordDirectoryVisit();
     return true;
 }
\ No newline at end of file
@@ -0,0 +1,168 @@
+#!/bin/sh
+# Scripted checks of the shell's expansions and statuses (make check).
+# Usage: ./check.sh ./cc
+#
+# Each case feeds a command script to the shell's stdin inside a scratch directory
+# and compares what it prints, with the prompts removed, against the expected text.
+# The cases cover arithmetic precedence and errors, glob edge cases, assignments and
+# export with quoting, the words builtins such as cache and pin pass on, and the status of
+# a fan-out.
+
+SHELL_BIN=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+SCRATCH=$(mktemp -d "${TMPDIR:-/tmp}/cc-check.XXXXXX")
+trap 'rm -rf "$SCRATCH"' EXIT
+FAILED=0
+
+# A few files, some with spaces or quotes in their names, a subdirectory and a symlink to it
+mkdir -p "$SCRATCH/g/real/sub" "$SCRATCH/n"
+touch "$SCRATCH/g/a.log" "$SCRATCH/g/b.log" "$SCRATCH/g/real/x.c" "$SCRATCH/g/real/sub/y.c"
+touch "$SCRATCH/n/a b.log" "$SCRATCH/n/it's.log" "$SCRATCH/n/q\"x.log"
+ln -s real "$SCRATCH/g/link"
+
+# Function to run one case: check NAME, with the script on fd 3 and the expected output on stdin
+check()
+{
+    cat > "$SCRATCH/expected"
+    (cd "$SCRATCH" && "$SHELL_BIN" <&3 2>&1) | sed -E 's/[^ @>]+@[^ :]+:[^>]*> //g' > "$SCRATCH/actual"
+    if cmp -s "$SCRATCH/expected" "$SCRATCH/actual"; then
+        echo "ok   $1"
+    else
+        echo "FAIL $1"
+        diff "$SCRATCH/expected" "$SCRATCH/actual"
+        FAILED=1
+    fi
+}
+
+check arithmetic 3<<'SCRIPT' <<'EXPECTED'
+echo $((1 + 2 * 3)) $(( (1 + 2) * 3 )) $((2 ** 3 ** 2)) $((-2 ** 2)) $((7 / 2)) $((-7 % 3))
+echo $((2--3)) $((2++3)) $((--5)) $((1 ? 2 : 3)) $((0 && 1/0)) $((1 << 4 | 1)) $((0x10 + 010))
+x=4
+echo $((x--)) $x $((--x)) $((x++ + 1)) $x $((x += 10)) $x
+let "i = 2 + 3" j=i*2
+echo $i $j
+echo $((1/0))
+echo status $?
+echo $((2 +))
+echo status $?
+exit
+SCRIPT
+7 9 512 4 3 -1
+5 5 5 2 0 17 24
+4 3 2 3 3 13 13
+5 10
+1/0: division by 0
+status 1
+2 +: syntax error: operand expected
+status 1
+EXPECTED
+
+check glob 3<<'SCRIPT' <<'EXPECTED'
+cd g
+/usr/bin/printf '<%s>' *.log ; /usr/bin/printf '\n'
+/usr/bin/printf '<%s>' *.none ; /usr/bin/printf '\n'
+touch c.log ; /usr/bin/printf '<%s>' *.log ; /usr/bin/printf '\n'
+/usr/bin/printf '<%s>' link/* ; /usr/bin/printf '\n'
+/usr/bin/printf '<%s>' **/*.c ; /usr/bin/printf '\n'
+/usr/bin/printf '<%s>' l*k/sub/*.c ; /usr/bin/printf '\n'
+cd ../n
+/usr/bin/printf '<%s>' *.log ; /usr/bin/printf '\n'
+/usr/bin/printf '<%s>' *.log | cat ; /usr/bin/printf '\n'
+/usr/bin/printf '<%s>' *.log > ../out.txt ; /bin/cat ../out.txt ; /usr/bin/printf '\n'
+echo *.log
+/usr/bin/printf '<%s>' "$(echo *.log)" ; /usr/bin/printf '\n'
+ls *.log
+exit
+SCRIPT
+<a.log><b.log>
+<*.none>
+<a.log><b.log><c.log>
+<link/sub><link/x.c>
+<real/sub/y.c><real/x.c>
+<link/sub/y.c>
+<a b.log><it's.log><q"x.log>
+<a b.log><it's.log><q"x.log>
+<a b.log><it's.log><q"x.log>
+a b.log it's.log q"x.log
+<a b.log it's.log q"x.log>
+a b.log
+it's.log
+q"x.log
+EXPECTED
+
+check quoting 3<<'SCRIPT' <<'EXPECTED'
+X="hello world"
+/usr/bin/printf '<%s>' $X "$X" '$X' ; /usr/bin/printf '\n'
+Y='a > b'
+/usr/bin/printf '<%s>' $Y ; /usr/bin/printf '\n'
+E=$X
+/usr/bin/printf '<%s>' "$E" ; /usr/bin/printf '\n'
+Q="it's"
+/usr/bin/printf '<%s>' $Q "$Q" ; /usr/bin/printf '\n'
+/usr/bin/printf '<%s>' $(echo "a;b") ; /usr/bin/printf '\n'
+Y='say "hi"'
+echo "$Y"
+echo $Y | cat
+echo "a   b"   c    'd  e' a"b c"d
+echo "$(echo "$Y")" > out.txt ; /bin/cat out.txt
+/bin/mkdir -p q/dir
+Z=1 cd q/dir
+pwd
+echo Z is "[$Z]"
+exit
+SCRIPT
+<hello><world><hello world><$X>
+<a><>><b>
+<hello world>
+<it's><it's>
+<a;b>
+say "hi"
+say "hi"
+a   b c d  e ab cd
+say "hi"
+/home/q/dir
+Z is []
+EXPECTED
+
+check export 3<<'SCRIPT' <<'EXPECTED'
+export X="a'b"
+/usr/bin/printf '<%s>' $X "$X" ; /usr/bin/printf '\n'
+Y='say "hi"'
+export Z=$Y
+printenv Z
+export W="two  spaces" V='$HOME'
+printenv W V
+exit
+SCRIPT
+<a'b><a'b>
+say "hi"
+two  spaces
+$HOME
+EXPECTED
+
+check builtin-words 3<<'SCRIPT' <<'EXPECTED'
+cache -- /usr/bin/printf '<%s>' "it's" "a  b" ; /usr/bin/printf '\n'
+cache -- echo "it's" "a  b"
+pin 0 /usr/bin/printf '<%s>' "it's" "a  b" ; /usr/bin/printf '\n'
+pin 0 echo "it's" "a  b"
+exit
+SCRIPT
+<it's><a  b>
+it's a  b
+<it's><a  b>
+it's a  b
+EXPECTED
+
+check fan-out 3<<'SCRIPT' <<'EXPECTED'
+seq 3 |& { false ; wc -l }
+echo status $?
+seq 3 |& { wc -l ; true }
+echo status $?
+exit
+SCRIPT
+3
+status 1
+3
+status 0
+EXPECTED
+
+exit $FAILED
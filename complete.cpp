@@ -0,0 +1,247 @@
+#include "complete.h"
+#include "builtins.h"
+#include <iostream>
+#include <algorithm>
+#include <map>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+// Prefix trie of command names. A name offered by several PATH directories
+// is counted once per directory so a refresh of one directory can remove it
+struct TrieNode
+{
+    vector<pair<char, int>> children; // Sorted by character
+    int count = 0;
+};
+
+struct PathDirState
+{
+    struct timespec mtime;
+    vector<string> names; // Executables this directory contributed to the trie
+};
+
+static vector<TrieNode> trie(1);
+static bool builtinsLoaded = false;
+static string cachedPath;
+static map<string, PathDirState> pathDirs;
+
+static int childNode(int node, char c, bool create)
+{
+    vector<pair<char, int>>& children = trie[node].children;
+    auto it = lower_bound(children.begin(), children.end(), make_pair(c, 0));
+    if (it != children.end() && it->first == c)
+        return it->second;
+    if (!create)
+        return -1;
+    int index = trie.size();
+    children.insert(it, make_pair(c, index)); // May not hold a reference across the push_back below
+    trie.push_back(TrieNode());
+    return index;
+}
+
+static void trieAdd(const string& word, int delta)
+{
+    int node = 0;
+    for (char c : word)
+    {
+        node = childNode(node, c, delta > 0);
+        if (node < 0)
+            return;
+    }
+    trie[node].count += delta;
+}
+
+static void trieCollect(int node, string& word, vector<string>& out)
+{
+    if (trie[node].count > 0)
+        out.push_back(word);
+    for (size_t i = 0; i < trie[node].children.size(); i++)
+    {
+        pair<char, int> child = trie[node].children[i];
+        word += child.first;
+        trieCollect(child.second, word, out);
+        word.erase(word.size() - 1);
+    }
+}
+
+static void scanPathDir(const string& dir, PathDirState& state)
+{
+    for (auto& name : state.names)
+        trieAdd(name, -1);
+    state.names.clear();
+
+    int dirFd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dirFd < 0)
+        return;
+    DIR* handle = fdopendir(dirFd);
+    if (handle == nullptr)
+    {
+        close(dirFd);
+        return;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(handle)) != nullptr)
+    {
+        if (entry->d_name[0] == '.' || entry->d_type == DT_DIR)
+            continue;
+        if (faccessat(dirFd, entry->d_name, X_OK, 0) != 0)
+            continue;
+        state.names.push_back(entry->d_name);
+        trieAdd(entry->d_name, 1);
+    }
+    closedir(handle);
+}
+
+// Function to bring the trie up to date: built on first use, then only the
+// PATH directories whose mtime changed are read again
+static void refreshCommandTrie()
+{
+    if (!builtinsLoaded)
+    {
+        size_t count;
+        const Builtin* builtins = listBuiltins(count);
+        for (size_t i = 0; i < count; i++)
+            trieAdd(builtins[i].name, 1);
+        builtinsLoaded = true;
+    }
+
+    const char* pathEnv = getenv("PATH");
+    string path = pathEnv ? pathEnv : "";
+    if (path != cachedPath)
+    {
+        // Directories that left PATH take their names with them
+        for (auto it = pathDirs.begin(); it != pathDirs.end();)
+        {
+            string needle = ":" + path + ":";
+            if (needle.find(":" + it->first + ":") == string::npos)
+            {
+                for (auto& name : it->second.names)
+                    trieAdd(name, -1);
+                it = pathDirs.erase(it);
+            }
+            else
+                ++it;
+        }
+        cachedPath = path;
+    }
+
+    size_t start = 0;
+    while (start <= path.size())
+    {
+        size_t colon = path.find(':', start);
+        if (colon == string::npos)
+            colon = path.size();
+        string dir = path.substr(start, colon - start);
+        start = colon + 1;
+        if (dir.empty())
+            continue;
+
+        struct stat info;
+        if (stat(dir.c_str(), &info) != 0)
+            continue;
+        auto found = pathDirs.find(dir);
+        if (found != pathDirs.end() && found->second.mtime.tv_sec == info.st_mtim.tv_sec &&
+            found->second.mtime.tv_nsec == info.st_mtim.tv_nsec)
+            continue;
+
+        PathDirState& state = pathDirs[dir];
+        state.mtime = info.st_mtim;
+        scanPathDir(dir, state);
+    }
+}
+
+vector<string> completeCommand(const string& prefix)
+{
+    refreshCommandTrie();
+    vector<string> matches;
+    int node = 0;
+    for (char c : prefix)
+    {
+        node = childNode(node, c, false);
+        if (node < 0)
+            return matches;
+    }
+    string word = prefix;
+    trieCollect(node, word, matches);
+    return matches;
+}
+
+// Function to complete a file path relative to the current directory; directories get a trailing /
+vector<string> completePath(const string& prefix)
+{
+    vector<string> matches;
+    size_t slash = prefix.rfind('/');
+    string dirPart = slash == string::npos ? "" : prefix.substr(0, slash + 1);
+    string base = slash == string::npos ? prefix : prefix.substr(slash + 1);
+
+    string dir = dirPart;
+    if (dir.compare(0, 2, "~/") == 0 && getenv("HOME") != nullptr)
+        dir = string(getenv("HOME")) + dir.substr(1);
+
+    DIR* handle = opendir(dir.empty() ? "." : dir.c_str());
+    if (handle == nullptr)
+        return matches;
+    struct dirent* entry;
+    while ((entry = readdir(handle)) != nullptr)
+    {
+        string name = entry->d_name;
+        if (name == "." || name == "..")
+            continue;
+        if (name[0] == '.' && (base.empty() || base[0] != '.'))
+            continue;
+        if (name.compare(0, base.size(), base) != 0)
+            continue;
+
+        bool isDir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN)
+        {
+            struct stat info;
+            isDir = stat((dir + name).c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+        }
+        matches.push_back(dirPart + name + (isDir ? "/" : ""));
+    }
+    closedir(handle);
+    sort(matches.begin(), matches.end());
+    return matches;
+}
+
+// Function to complete the word ending at cursor: command names in command
+// position, file paths everywhere else
+vector<string> completeWord(const string& line, size_t cursor, size_t& wordStart)
+{
+    wordStart = cursor;
+    while (wordStart > 0 && !isspace((unsigned char)line[wordStart - 1]))
+        wordStart--;
+    string word = line.substr(wordStart, cursor - wordStart);
+
+    // Command position: nothing but blanks since the line start or the last ; | &
+    size_t before = wordStart;
+    while (before > 0 && isspace((unsigned char)line[before - 1]))
+        before--;
+    bool commandPosition = before == 0 || strchr(";|&", line[before - 1]) != nullptr;
+
+    if (commandPosition && word.find('/') == string::npos)
+        return completeCommand(word);
+    return completePath(word);
+}
+
+string commonPrefix(const vector<string>& words)
+{
+    if (words.empty())
+        return "";
+    string prefix = words[0];
+    for (auto& word : words)
+    {
+        size_t i = 0;
+        while (i < prefix.size() && i < word.size() && prefix[i] == word[i])
+            i++;
+        prefix.erase(i);
+    }
+    return prefix;
+}
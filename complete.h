@@ -0,0 +1,15 @@
+#ifndef COMPLETE_H
+#define COMPLETE_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Function declarations
+vector<string> completeCommand(const string& prefix);
+vector<string> completePath(const string& prefix);
+vector<string> completeWord(const string& line, size_t cursor, size_t& wordStart);
+string commonPrefix(const vector<string>& words);
+
+#endif // COMPLETE_H
@@ -1,65 +1,18 @@
 #include "echo.h"
-#include <unistd.h>
 #include <iostream>
-#include <vector>
 
 using namespace std;
 
-vector<string> echotokenize(const string& input)
+// Function to print the words after `echo`, one space apart. The shell has already split
+// them and removed their quotes, so "a   b" keeps its spaces and expansions print as they are
+void echoPrinting(const vector<string>& tokens)
 {
-    vector<string> tokens;
-    bool inQuotes = false;
-    string token;
-
-    for (char c : input) 
+    string line;
+    for (size_t i = 1; i < tokens.size(); i++)
     {
-        if (c == '"') 
-        {
-            inQuotes = !inQuotes;
-            token += c;
-        } 
-        else if (isspace(c) && inQuotes == false) 
-        {
-            if (!token.empty()) 
-            {
-                tokens.push_back(token + " ");
-                token.clear();
-            }
-        } 
-        else 
-        {
-            token += c;
-        }
+        if (i > 1)
+            line += ' ';
+        line += tokens[i];
     }
-
-    if (token.empty() == false) 
-    {
-        tokens.push_back(token);
-    }
-
-    return tokens;
+    cout << line << endl;
 }
-
-void echoPrinting(const string& input)
-{
-    vector<string> echotokens = echotokenize(input);
-    for(long unsigned int i = 1; i < echotokens.size(); i++)
-    {
-        string str;
-        bool doubleQuotes = false;
-        for(long unsigned int j = 0; j < echotokens[i].size(); j++)
-        {
-            if(echotokens[i][j] == '"')
-            {
-                doubleQuotes = true;
-                continue;
-            }
-            if(doubleQuotes == false and echotokens[i][j] == '\'')
-                continue;
-            else
-                str += echotokens[i][j];
-        }
-        cout << str;
-    }
-    cout << endl;
-}
\ No newline at end of file
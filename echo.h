@@ -6,7 +6,6 @@
 
 using namespace std;
 
-vector<string> echotokenize(const string& input);
-void echoPrinting(const string& input);
+void echoPrinting(const vector<string>& tokens);
 
 #endif // ECHO_H
\ No newline at end of file
@@ -0,0 +1,421 @@
+#include "expand.h"
+#include "shell.h"
+#include "vars.h"
+#include "builtins.h"
+#include "arith.h"
+#include "glob.h"
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+// Function to run a builtin with cout pointed at a string, returns false if it is not eligible
+static bool captureBuiltin(const string& command, string& output, string& baseDir, string& currentDir, vector<string>& history, int& status)
+{
+    if (command.find_first_of("|;<>&`") != string::npos)
+        return false;
+
+    vector<string> tokens = tokenize(command);
+    expandGlobs(tokens);
+    // Only builtins that write to cout and change no shell state run without a fork
+    const Builtin* builtin = tokens.empty() ? nullptr : findBuiltin(tokens[0]);
+    if (builtin == nullptr || !(builtin->flags & BUILTIN_CAPTURE))
+        return false;
+
+    ostringstream buffer;
+    streambuf* saved = cout.rdbuf(buffer.rdbuf());
+    bool ok = executeCommand(tokens, baseDir, currentDir, command, history, status);
+    cout.rdbuf(saved);
+
+    lastExitStatus = ok ? 0 : 1;
+    output = buffer.str();
+    return true;
+}
+
+// Function to run a command line and return everything it wrote to stdout
+string captureCommandOutput(const string& command, string& baseDir, string& currentDir, vector<string>& history, int& status)
+{
+    string output;
+
+    // Expand here only for a lone capturable builtin; a forked subshell expands
+    // the line itself, and expanding twice would run nested substitutions twice
+    vector<string> words = tokenize(command);
+    const Builtin* builtin = words.empty() ? nullptr : findBuiltin(words[0]);
+    if (builtin != nullptr && (builtin->flags & BUILTIN_CAPTURE) && command.find_first_of("|;<>&") == string::npos)
+    {
+        string expanded;
+        if (!expandCommandLine(command, expanded, baseDir, currentDir, history, status))
+        {
+            lastExitStatus = 1;
+            return output;
+        }
+        if (captureBuiltin(trim(expanded), output, baseDir, currentDir, history, status))
+            return output;
+    }
+
+    int fds[2];
+    if (pipe(fds) < 0)
+    {
+        perror("substitution: pipe");
+        return output;
+    }
+
+    cout.flush();
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror("substitution: fork");
+        close(fds[0]);
+        close(fds[1]);
+        return output;
+    }
+    if (pid == 0)
+    {
+        close(fds[0]);
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[1]);
+
+        // A substitution is a subshell: exit and cd only affect it
+        int subStatus = 1;
+        executeInputLine(command, baseDir, currentDir, history, subStatus);
+        cout.flush();
+        _exit(lastExitStatus);
+    }
+
+    close(fds[1]);
+    char chunk[4096];
+    while (true)
+    {
+        ssize_t n = read(fds[0], chunk, sizeof(chunk));
+        if (n > 0)
+        {
+            output.append(chunk, n); // string grows geometrically, no temp file involved
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        break;
+    }
+    close(fds[0]);
+
+    int waitStatus;
+    waitpid(pid, &waitStatus, 0);
+    lastExitStatus = WIFEXITED(waitStatus) ? WEXITSTATUS(waitStatus) : 128 + WTERMSIG(waitStatus);
+    return output;
+}
+
+// Function to find the ) closing the $(, <( or >( that starts at open, or npos
+static size_t findClosingParen(const string& text, size_t open)
+{
+    int depth = 0;
+    char quote = 0;
+    for (size_t i = open; i < text.size(); i++)
+    {
+        char c = text[i];
+        if (quote != 0)
+        {
+            if (c == quote)
+                quote = 0;
+        }
+        else if (c == '\'' || c == '"')
+            quote = c;
+        else if (c == '(')
+            depth++;
+        else if (c == ')' && --depth == 0)
+            return i;
+    }
+    return string::npos;
+}
+
+// Function to find the last ) of the $(( ... )) that starts at dollar, or npos if
+// the parentheses do not close as a pair, as in $((cmd) | other)
+static size_t arithmeticEnd(const string& command, size_t dollar)
+{
+    size_t close = findClosingParen(command, dollar + 1);
+    if (close == string::npos || command[close - 1] != ')' || findClosingParen(command, dollar + 2) != close - 1)
+        return string::npos;
+    return close;
+}
+
+// Process substitutions made for the current command: the shell's end of each
+// pipe, which the command opens as /dev/fd/N, and the process on the other end
+struct ProcessSubstitution
+{
+    int fd;
+    pid_t pid;
+};
+
+static vector<ProcessSubstitution> activeSubstitutions;
+
+// Function to start cmd for <(cmd) (reading true) or >(cmd) and return the path that replaces it
+static string startProcessSubstitution(const string& inner, bool reading, string& baseDir, string& currentDir, vector<string>& history, int& status)
+{
+    // Not O_CLOEXEC: the consuming command has to inherit the shell's end through exec
+    int fds[2];
+    if (pipe(fds) < 0)
+    {
+        perror("substitution: pipe");
+        return "";
+    }
+    int keep = reading ? fds[0] : fds[1];
+    int give = reading ? fds[1] : fds[0];
+
+    cout.flush();
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror("substitution: fork");
+        close(fds[0]);
+        close(fds[1]);
+        return "";
+    }
+    if (pid == 0)
+    {
+        // Ends of other substitutions would keep their readers from ever seeing EOF
+        close(keep);
+        for (auto& substitution : activeSubstitutions)
+            close(substitution.fd);
+        activeSubstitutions.clear();
+        dup2(give, reading ? STDOUT_FILENO : STDIN_FILENO);
+        close(give);
+
+        int subStatus = 1;
+        executeInputLine(inner, baseDir, currentDir, history, subStatus);
+        cout.flush();
+        _exit(lastExitStatus);
+    }
+
+    close(give);
+    activeSubstitutions.push_back({keep, pid});
+    return "/dev/fd/" + to_string(keep);
+}
+
+// Function to close the shell's ends once the consuming command is done, then reap the substitutions.
+// Readers of >(cmd) see EOF and writers to <(cmd) that were not drained get SIGPIPE
+void finishProcessSubstitutions()
+{
+    for (auto& substitution : activeSubstitutions)
+        close(substitution.fd);
+    for (auto& substitution : activeSubstitutions)
+    {
+        int waitStatus;
+        while (waitpid(substitution.pid, &waitStatus, 0) < 0 && errno == EINTR)
+            ;
+    }
+    activeSubstitutions.clear();
+}
+
+// Function to check for open <(...) or >(...): their /dev/fd paths name fds of this process
+bool processSubstitutionsActive()
+{
+    return !activeSubstitutions.empty();
+}
+
+// Function to substitute one command's output: trailing newlines go, and
+// outside double quotes the remaining newlines become word separators
+static string substitute(const string& inner, bool inDoubleQuotes, string& baseDir, string& currentDir, vector<string>& history, int& status)
+{
+    string output = captureCommandOutput(inner, baseDir, currentDir, history, status);
+    size_t end = output.find_last_not_of('\n');
+    output.erase(end == string::npos ? 0 : end + 1);
+    if (!inDoubleQuotes)
+    {
+        for (auto& c : output)
+        {
+            if (c == '\n')
+                c = ' ';
+        }
+    }
+    return output;
+}
+
+// Function to expand $NAME, ${NAME}, $? or $$ starting at the $ at pos into value; advances pos past it
+static bool expandVariable(const string& command, size_t& pos, string& value)
+{
+    value.clear();
+    size_t start = pos + 1;
+    if (start >= command.size())
+        return false;
+
+    string name;
+    size_t end;
+    if (command[start] == '{')
+    {
+        end = command.find('}', start);
+        if (end == string::npos)
+            return false;
+        name = command.substr(start + 1, end - start - 1);
+        end++;
+    }
+    else if (command[start] == '?' || command[start] == '$')
+    {
+        name = command[start];
+        end = start + 1;
+    }
+    else
+    {
+        end = start;
+        while (end < command.size() && (isalnum((unsigned char)command[end]) || command[end] == '_'))
+            end++;
+        name = command.substr(start, end - start);
+        if (!isValidVariableName(name))
+            return false;
+    }
+
+    if (name == "?")
+        value = to_string(lastExitStatus);
+    else if (name == "$")
+        value = to_string(getpid());
+    else
+    {
+        const string* found = lookupVariable(name);
+        if (found != nullptr)
+            value = *found;
+    }
+    pos = end - 1;
+    return true;
+}
+
+// Function to check if text ends inside the value of a NAME=value word of the command, as in
+// `X=$Y cmd` or `export X=$Y`; such a value stays one word
+static bool inAssignmentValue(const string& text)
+{
+    if (text.empty() || isspace((unsigned char)text.back()))
+        return false;
+    vector<string> words = tokenize(text);
+    size_t first = !words.empty() && words[0] == "export" ? 1 : 0;
+    if (first == words.size())
+        return false;
+    for (size_t i = first; i < words.size(); i++)
+    {
+        if (!isAssignment(words[i]))
+            return false;
+    }
+    return true;
+}
+
+// Function to append the result of an expansion. Outside quotes it may split into words at
+// whitespace, as in bash, but it is never parsed again: quotes, <, > and & in it are data
+static void appendExpansion(string& result, const string& text, bool inDoubleQuotes)
+{
+    if (inDoubleQuotes)
+    {
+        // A " in the value closes the quotes, adds a quoted " and opens them again
+        for (char c : text)
+            result += c == '"' ? string("\"'\"'\"") : string(1, c);
+        return;
+    }
+    bool syntax = text.find_first_of("'\"<>&;|") != string::npos;
+    if (!syntax && text.find_first_of(" \t\n") == string::npos)
+    {
+        result += text; // One word with nothing that could be read as syntax
+        return;
+    }
+    if (inAssignmentValue(result))
+    {
+        result += quoteWord(text);
+        return;
+    }
+    if (!syntax)
+    {
+        result += text; // Splits into words at its whitespace
+        return;
+    }
+
+    string word;
+    for (char c : text)
+    {
+        if (isspace((unsigned char)c))
+        {
+            result += quoteWord(word);
+            result += c;
+            word.clear();
+        }
+        else
+        {
+            word += c;
+        }
+    }
+    result += quoteWord(word);
+}
+
+// Function to expand variables, $((...)), $(...), `...`, <(...) and >(...) in one command, leaving single-quoted text alone.
+// Returns false, with the error reported, if an arithmetic expansion fails: the command must not run
+bool expandCommandLine(const string& command, string& expanded, string& baseDir, string& currentDir, vector<string>& history, int& status)
+{
+    if (command.find_first_of("$`<>") == string::npos)
+    {
+        expanded = command; // Fast path: nothing to expand
+        return true;
+    }
+
+    string result, value;
+    result.reserve(command.size());
+    bool inSingle = false, inDouble = false;
+
+    for (size_t i = 0; i < command.size(); i++)
+    {
+        char c = command[i];
+        if (c == '\'' && !inDouble)
+            inSingle = !inSingle;
+        else if (c == '"' && !inSingle)
+            inDouble = !inDouble;
+        else if (!inSingle && c == '$' && command.compare(i + 1, 2, "((") == 0 && arithmeticEnd(command, i) != string::npos)
+        {
+            size_t close = arithmeticEnd(command, i);
+            string text = command.substr(i + 3, close - i - 4);
+
+            // Command substitutions inside are run first; variables are read by the evaluator
+            if ((text.find("$(") != string::npos || text.find('`') != string::npos) && !expandCommandLine(text, text, baseDir, currentDir, history, status))
+                return false;
+            long long value;
+            if (!evaluateArithmetic(text, value))
+                return false;
+            result += to_string(value);
+            i = close;
+            continue;
+        }
+        else if (!inSingle && c == '$' && i + 1 < command.size() && command[i + 1] == '(')
+        {
+            size_t close = findClosingParen(command, i + 1);
+            if (close != string::npos)
+            {
+                appendExpansion(result, substitute(command.substr(i + 2, close - i - 2), inDouble, baseDir, currentDir, history, status), inDouble);
+                i = close;
+                continue;
+            }
+        }
+        else if (!inSingle && !inDouble && (c == '<' || c == '>') && i + 1 < command.size() && command[i + 1] == '(')
+        {
+            size_t close = findClosingParen(command, i + 1);
+            if (close != string::npos)
+            {
+                result += startProcessSubstitution(command.substr(i + 2, close - i - 2), c == '<', baseDir, currentDir, history, status);
+                i = close;
+                continue;
+            }
+        }
+        else if (!inSingle && c == '$' && expandVariable(command, i, value))
+        {
+            appendExpansion(result, value, inDouble);
+            continue;
+        }
+        else if (!inSingle && c == '`')
+        {
+            size_t close = command.find('`', i + 1);
+            if (close != string::npos)
+            {
+                appendExpansion(result, substitute(command.substr(i + 1, close - i - 1), inDouble, baseDir, currentDir, history, status), inDouble);
+                i = close;
+                continue;
+            }
+        }
+        result += c;
+    }
+    expanded = result;
+    return true;
+}
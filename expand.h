@@ -0,0 +1,15 @@
+#ifndef EXPAND_H
+#define EXPAND_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Function declarations
+string captureCommandOutput(const string& command, string& baseDir, string& currentDir, vector<string>& history, int& status);
+bool expandCommandLine(const string& command, string& expanded, string& baseDir, string& currentDir, vector<string>& history, int& status);
+void finishProcessSubstitutions();
+bool processSubstitutionsActive();
+
+#endif // EXPAND_H
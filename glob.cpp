@@ -0,0 +1,331 @@
+#include "glob.h"
+#include "vars.h"
+#include <iostream>
+#include <algorithm>
+#include <bitset>
+#include <map>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+enum AtomKind { ATOM_LITERAL, ATOM_ANY, ATOM_STAR, ATOM_CLASS };
+
+struct GlobAtom
+{
+    AtomKind kind;
+    char literal;
+    bitset<256> members; // For [...] classes, negation already applied
+};
+
+// One path component of a pattern, compiled once and matched against many names
+struct GlobSegment
+{
+    string text;
+    bool isLiteral;       // No wildcards at all: only an existence check is needed
+    bool isRecursive;     // The segment is exactly **
+    bool matchesDotFiles; // Pattern starts with '.', so hidden names may match
+    string prefix;        // Literal characters before the first wildcard
+    vector<GlobAtom> atoms;
+};
+
+struct DirEntryInfo
+{
+    string name;
+    bool isDir;  // Directory, or a symlink to one
+    bool isLink; // Symlinks are matched but not descended by **
+};
+
+// Directory listings read while expanding the current command, shared by all its words
+static map<string, vector<DirEntryInfo>> dirCache;
+
+bool hasGlobChars(const string& word)
+{
+    return word.find_first_of("*?[") != string::npos;
+}
+
+static GlobSegment compileSegment(const string& text)
+{
+    GlobSegment segment;
+    segment.text = text;
+    segment.isRecursive = text == "**";
+    segment.isLiteral = !hasGlobChars(text);
+    segment.matchesDotFiles = !text.empty() && text[0] == '.';
+
+    size_t i = 0;
+    while (i < text.size())
+    {
+        char c = text[i];
+        GlobAtom atom;
+        atom.kind = ATOM_LITERAL;
+        atom.literal = c;
+
+        if (c == '*')
+        {
+            atom.kind = ATOM_STAR;
+            while (i + 1 < text.size() && text[i + 1] == '*')
+                i++; // Consecutive stars are one star within a component
+        }
+        else if (c == '?')
+        {
+            atom.kind = ATOM_ANY;
+        }
+        else if (c == '[')
+        {
+            // Parse a bracket expression; an unterminated one is a literal '['
+            size_t j = i + 1;
+            bool negate = false;
+            if (j < text.size() && (text[j] == '!' || text[j] == '^'))
+            {
+                negate = true;
+                j++;
+            }
+            bitset<256> members;
+            bool first = true;
+            while (j < text.size() && (text[j] != ']' || first))
+            {
+                unsigned char lo = text[j];
+                if (j + 2 < text.size() && text[j + 1] == '-' && text[j + 2] != ']')
+                {
+                    unsigned char hi = text[j + 2];
+                    for (unsigned int ch = lo; ch <= hi; ch++)
+                        members.set(ch);
+                    j += 3;
+                }
+                else
+                {
+                    members.set(lo);
+                    j++;
+                }
+                first = false;
+            }
+            if (j < text.size())
+            {
+                atom.kind = ATOM_CLASS;
+                atom.members = negate ? ~members : members;
+                i = j;
+            }
+        }
+        else if (c == '\\' && i + 1 < text.size())
+        {
+            atom.literal = text[++i];
+        }
+
+        if (atom.kind == ATOM_LITERAL && segment.atoms.size() == segment.prefix.size())
+            segment.prefix += atom.literal;
+        segment.atoms.push_back(atom);
+        i++;
+    }
+    return segment;
+}
+
+static bool atomMatches(const GlobAtom& atom, unsigned char c)
+{
+    switch (atom.kind)
+    {
+        case ATOM_LITERAL: return atom.literal == (char)c;
+        case ATOM_ANY: return true;
+        case ATOM_CLASS: return atom.members.test(c);
+        default: return false;
+    }
+}
+
+// Function to match a name against compiled atoms. Only the most recent star
+// is ever retried, so the scan is O(name * pattern) with no exponential backtracking
+static bool matchAtoms(const vector<GlobAtom>& atoms, size_t start, const char* name, size_t length)
+{
+    size_t a = start, n = 0;
+    size_t starAtom = string::npos, starName = 0;
+
+    while (n < length)
+    {
+        if (a < atoms.size() && atoms[a].kind == ATOM_STAR)
+        {
+            starAtom = a++;
+            starName = n;
+        }
+        else if (a < atoms.size() && atomMatches(atoms[a], name[n]))
+        {
+            a++;
+            n++;
+        }
+        else if (starAtom != string::npos)
+        {
+            a = starAtom + 1;
+            n = ++starName;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    while (a < atoms.size() && atoms[a].kind == ATOM_STAR)
+        a++;
+    return a == atoms.size();
+}
+
+static bool segmentMatches(const GlobSegment& segment, const string& name)
+{
+    if (name[0] == '.' && !segment.matchesDotFiles)
+        return false;
+    // Literal prefix fast path: most names are rejected by one memcmp
+    if (name.size() < segment.prefix.size() || memcmp(name.data(), segment.prefix.data(), segment.prefix.size()) != 0)
+        return false;
+    return matchAtoms(segment.atoms, segment.prefix.size(), name.data() + segment.prefix.size(), name.size() - segment.prefix.size());
+}
+
+bool globMatch(const string& pattern, const string& name)
+{
+    return segmentMatches(compileSegment(pattern), name);
+}
+
+// Function to list a directory once per command; later words reuse the listing
+static const vector<DirEntryInfo>& readDirectory(const string& dir)
+{
+    auto cached = dirCache.find(dir);
+    if (cached != dirCache.end())
+        return cached->second;
+
+    vector<DirEntryInfo>& entries = dirCache[dir];
+    DIR* handle = opendir(dir.empty() ? "." : dir.c_str());
+    if (handle == nullptr)
+        return entries;
+
+    struct dirent* entry;
+    while ((entry = readdir(handle)) != nullptr)
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        DirEntryInfo info;
+        info.name = entry->d_name;
+        info.isLink = entry->d_type == DT_LNK;
+        if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK)
+        {
+            // Symlinks to directories count as directories for matching but not for **
+            struct stat st;
+            string full = (dir.empty() ? "" : dir + "/") + info.name;
+            if (entry->d_type == DT_UNKNOWN && lstat(full.c_str(), &st) == 0 && S_ISLNK(st.st_mode))
+                info.isLink = true;
+            info.isDir = stat(full.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+        }
+        else
+        {
+            info.isDir = entry->d_type == DT_DIR;
+        }
+        entries.push_back(info);
+    }
+    closedir(handle);
+    return entries;
+}
+
+static string joinPath(const string& dir, const string& name)
+{
+    if (dir.empty())
+        return name;
+    if (dir[dir.size() - 1] == '/')
+        return dir + name;
+    return dir + "/" + name;
+}
+
+static void expandSegments(const string& dir, const vector<GlobSegment>& segments, size_t index, bool dirsOnly, vector<string>& results)
+{
+    if (index == segments.size())
+    {
+        results.push_back(dirsOnly ? dir + "/" : dir);
+        return;
+    }
+    const GlobSegment& segment = segments[index];
+    bool last = index + 1 == segments.size() && !dirsOnly;
+
+    if (segment.isRecursive)
+    {
+        // ** matches this directory and every directory below it
+        expandSegments(dir, segments, index + 1, dirsOnly, results);
+        for (auto& entry : readDirectory(dir))
+        {
+            if (entry.isDir && !entry.isLink && entry.name[0] != '.')
+                expandSegments(joinPath(dir, entry.name), segments, index, dirsOnly, results);
+        }
+        return;
+    }
+
+    if (segment.isLiteral)
+    {
+        string path = joinPath(dir, segment.text);
+        struct stat st;
+        if (last ? lstat(path.c_str(), &st) == 0 : stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+            expandSegments(path, segments, index + 1, dirsOnly, results);
+        return;
+    }
+
+    for (auto& entry : readDirectory(dir))
+    {
+        if ((last || entry.isDir) && segmentMatches(segment, entry.name))
+            expandSegments(joinPath(dir, entry.name), segments, index + 1, dirsOnly, results);
+    }
+}
+
+// Function to expand one pattern into the sorted list of matching paths
+vector<string> expandGlob(const string& pattern)
+{
+    vector<GlobSegment> segments;
+    string root;
+    size_t start = 0;
+    if (!pattern.empty() && pattern[0] == '/')
+    {
+        root = "/";
+        start = 1;
+    }
+    while (start <= pattern.size())
+    {
+        size_t slash = pattern.find('/', start);
+        if (slash == string::npos)
+            slash = pattern.size();
+        if (slash > start)
+            segments.push_back(compileSegment(pattern.substr(start, slash - start)));
+        start = slash + 1;
+    }
+
+    // A trailing slash only matches directories, and keeps the slash
+    bool dirsOnly = pattern.size() > 1 && pattern[pattern.size() - 1] == '/';
+
+    vector<string> results;
+    if (!segments.empty())
+        expandSegments(root, segments, 0, dirsOnly, results);
+    sort(results.begin(), results.end());
+    results.erase(unique(results.begin(), results.end()), results.end());
+    return results;
+}
+
+// Function to replace every unquoted wildcard word by its matches; words with no match stay as typed.
+// The words are still shell words, so a match with spaces or quotes in its name is quoted
+void expandGlobs(vector<string>& tokens)
+{
+    vector<string> expanded;
+    bool changed = false;
+    for (auto& token : tokens)
+    {
+        if (!hasGlobChars(token) || token.find_first_of("\"'") != string::npos)
+        {
+            expanded.push_back(token);
+            continue;
+        }
+        vector<string> matches = expandGlob(token);
+        if (matches.empty())
+        {
+            expanded.push_back(token);
+            continue;
+        }
+        for (const string& match : matches)
+            expanded.push_back(quoteWord(match));
+        changed = true;
+    }
+    if (changed)
+        tokens.swap(expanded);
+}
+
+void resetGlobCache()
+{
+    dirCache.clear();
+}
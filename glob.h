@@ -0,0 +1,16 @@
+#ifndef GLOB_H
+#define GLOB_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Function declarations
+bool hasGlobChars(const string& word);
+bool globMatch(const string& pattern, const string& name);
+vector<string> expandGlob(const string& pattern);
+void expandGlobs(vector<string>& tokens);
+void resetGlobCache();
+
+#endif // GLOB_H
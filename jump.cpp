@@ -0,0 +1,348 @@
+#include "jump.h"
+#include "cd.h"
+#include "shell.h"
+#include "vars.h"
+#include "prompt.h"
+#include <iostream>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <ctime>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+// The database is an append-only file: the magic, then one record per visit:
+//   uint32 time | uint32 count | uint16 length | path bytes
+// A visit appends count 1; compaction rewrites one record per directory.
+static const char jumpMagic[8] = {'C', 'C', 'J', 'U', 'M', 'P', '1', '\n'};
+static const size_t recordHeader = 10;
+static const uint64_t maxTotalCount = 10000; // Counts are halved above this, dropping stale paths
+
+struct JumpEntry
+{
+    uint32_t count = 0;
+    uint32_t lastVisit = 0;
+};
+
+static unordered_map<string, JumpEntry> entries;
+static bool loaded = false;
+static int appendFd = -1;
+static vector<string> dirStack;
+
+// Function to find the database: $JUMP_DB, else ~/.cc_jump
+static string databasePath()
+{
+    const string* path = lookupVariable("JUMP_DB");
+    if (path != nullptr && !path->empty())
+        return *path;
+    const string* home = lookupVariable("HOME");
+    return (home != nullptr ? *home : string(".")) + "/.cc_jump";
+}
+
+static void encodeRecord(string& out, const string& path, uint32_t visit, uint32_t count)
+{
+    uint16_t length = path.size() > 0xffff ? 0xffff : (uint16_t)path.size();
+    out.append((const char*)&visit, 4);
+    out.append((const char*)&count, 4);
+    out.append((const char*)&length, 2);
+    out.append(path, 0, length);
+}
+
+// Function to rewrite the log with one record per directory, through a rename
+static void compactDatabase()
+{
+    uint64_t total = 0;
+    for (const auto& entry : entries)
+        total += entry.second.count;
+    if (total > maxTotalCount)
+    {
+        for (auto it = entries.begin(); it != entries.end();)
+        {
+            it->second.count /= 2;
+            if (it->second.count == 0)
+                it = entries.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    string data(jumpMagic, sizeof(jumpMagic));
+    for (const auto& entry : entries)
+        encodeRecord(data, entry.first, entry.second.lastVisit, entry.second.count);
+
+    string path = databasePath();
+    string temp = path + ".tmp";
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return;
+    bool ok = write(fd, data.data(), data.size()) == (ssize_t)data.size();
+    close(fd);
+    if (!ok || rename(temp.c_str(), path.c_str()) != 0)
+    {
+        unlink(temp.c_str());
+        return;
+    }
+    if (appendFd >= 0)
+    {
+        close(appendFd); // Still points at the replaced file
+        appendFd = -1;
+    }
+}
+
+// Function to map the database and fold its records into the index, once
+static void loadDatabase()
+{
+    if (loaded)
+        return;
+    loaded = true;
+
+    int fd = open(databasePath().c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(jumpMagic))
+    {
+        close(fd);
+        return;
+    }
+    size_t size = info.st_size;
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return;
+
+    const char* data = (const char*)mapped;
+    size_t records = 0;
+    if (memcmp(data, jumpMagic, sizeof(jumpMagic)) == 0)
+    {
+        size_t offset = sizeof(jumpMagic);
+        while (offset + recordHeader <= size)
+        {
+            uint32_t visit, count;
+            uint16_t length;
+            memcpy(&visit, data + offset, 4);
+            memcpy(&count, data + offset + 4, 4);
+            memcpy(&length, data + offset + 8, 2);
+            if (offset + recordHeader + length > size)
+                break; // Torn tail from an interrupted append
+            JumpEntry& entry = entries[string(data + offset + recordHeader, length)];
+            entry.count += count;
+            entry.lastVisit = max(entry.lastVisit, visit);
+            offset += recordHeader + length;
+            records++;
+        }
+    }
+    else
+    {
+        cerr << "z: ignoring unrecognised database " << databasePath() << endl;
+    }
+    munmap(mapped, size);
+
+    if (records > 2 * entries.size() + 256)
+        compactDatabase();
+}
+
+// Function to append the current directory to the database after a successful cd
+void recordDirectoryVisit()
+{
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd)) == nullptr)
+        return;
+    uint32_t now = (uint32_t)time(nullptr);
+
+    if (appendFd < 0)
+    {
+        appendFd = open(databasePath().c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+        if (appendFd < 0)
+            return;
+        struct stat info;
+        if (fstat(appendFd, &info) == 0 && info.st_size == 0 && write(appendFd, jumpMagic, sizeof(jumpMagic)) < 0)
+            return;
+    }
+
+    // One write per record, so appends from concurrent shells never interleave
+    string record;
+    encodeRecord(record, cwd, now, 1);
+    if (write(appendFd, record.data(), record.size()) < 0)
+        perror("z: write");
+
+    if (loaded)
+    {
+        JumpEntry& entry = entries[cwd];
+        entry.count++;
+        entry.lastVisit = now;
+    }
+}
+
+// Function to weight the visit count by how recently the directory was used
+static double frecency(const JumpEntry& entry, uint32_t now)
+{
+    uint32_t age = now > entry.lastVisit ? now - entry.lastVisit : 0;
+    double weight = age < 3600 ? 4 : age < 86400 ? 2 : age < 604800 ? 0.5 : 0.25;
+    return entry.count * weight;
+}
+
+// Function to check that every query word occurs in the path, in order
+static bool matchesQuery(const string& path, const vector<string>& words, bool ignoreCase)
+{
+    size_t position = 0;
+    for (const string& word : words)
+    {
+        size_t found = string::npos;
+        if (!ignoreCase)
+        {
+            found = path.find(word, position);
+        }
+        else
+        {
+            for (size_t i = position; i + word.size() <= path.size(); i++)
+            {
+                if (strncasecmp(path.c_str() + i, word.c_str(), word.size()) == 0)
+                {
+                    found = i;
+                    break;
+                }
+            }
+        }
+        if (found == string::npos)
+            return false;
+        position = found + word.size();
+    }
+    return true;
+}
+
+static bool enterDirectory(const string& path)
+{
+    if (!changeDirectory(path, previousDir))
+        return false;
+    promptDirectoryChanged();
+    return true;
+}
+
+// Function to implement `z [-l] query...`, also reached as `cd -j query...`
+bool runJump(const vector<string>& tokens)
+{
+    bool list = false;
+    vector<string> words;
+    for (size_t i = 1; i < tokens.size(); i++)
+    {
+        if (tokens[i] == "-l")
+            list = true;
+        else
+            words.push_back(tokens[i]);
+    }
+
+    if (!list && words.size() == 1)
+    {
+        struct stat info;
+        if (stat(words[0].c_str(), &info) == 0 && S_ISDIR(info.st_mode))
+            return enterDirectory(words[0]);
+    }
+
+    loadDatabase();
+    char cwd[PATH_MAX];
+    string current = getcwd(cwd, sizeof(cwd)) != nullptr ? cwd : "";
+    uint32_t now = (uint32_t)time(nullptr);
+
+    // Case-sensitive matches win; fall back to ignoring case if there are none
+    vector<pair<double, string>> matches;
+    for (int pass = 0; pass < 2 && matches.empty(); pass++)
+    {
+        for (const auto& entry : entries)
+        {
+            if (matchesQuery(entry.first, words, pass == 1))
+                matches.push_back(make_pair(frecency(entry.second, now), entry.first));
+        }
+    }
+    sort(matches.begin(), matches.end(), [](const pair<double, string>& a, const pair<double, string>& b)
+    {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+
+    if (list)
+    {
+        for (const auto& match : matches)
+        {
+            char score[32];
+            snprintf(score, sizeof(score), "%10.1f  ", match.first);
+            cout << score << match.second << endl;
+        }
+        return true;
+    }
+
+    for (const auto& match : matches)
+    {
+        struct stat info;
+        if (match.second == current || stat(match.second.c_str(), &info) != 0 || !S_ISDIR(info.st_mode))
+            continue; // Removed directories stay in the log until compaction drops them
+        return enterDirectory(match.second);
+    }
+    cerr << "z: no match" << endl;
+    return false;
+}
+
+bool runDirs(const vector<string>& tokens)
+{
+    char cwd[PATH_MAX];
+    cout << (getcwd(cwd, sizeof(cwd)) != nullptr ? cwd : "?");
+    for (auto it = dirStack.rbegin(); it != dirStack.rend(); ++it)
+        cout << " " << *it;
+    cout << endl;
+    return true;
+}
+
+// Function to implement `pushd [dir]`; with no argument the top two entries swap
+bool runPushd(const vector<string>& tokens)
+{
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd)) == nullptr)
+    {
+        perror("pushd");
+        return false;
+    }
+
+    if (tokens.size() == 1)
+    {
+        if (dirStack.empty())
+        {
+            cerr << "pushd: no other directory" << endl;
+            return false;
+        }
+        if (!enterDirectory(dirStack.back()))
+            return false;
+        dirStack.back() = cwd;
+    }
+    else if (tokens.size() == 2)
+    {
+        if (!enterDirectory(tokens[1]))
+            return false;
+        dirStack.push_back(cwd);
+    }
+    else
+    {
+        cerr << "pushd: too many arguments" << endl;
+        return false;
+    }
+    return runDirs(tokens);
+}
+
+bool runPopd(const vector<string>& tokens)
+{
+    if (dirStack.empty())
+    {
+        cerr << "popd: directory stack empty" << endl;
+        return false;
+    }
+    if (!enterDirectory(dirStack.back()))
+        return false;
+    dirStack.pop_back();
+    return runDirs(tokens);
+}
@@ -0,0 +1,16 @@
+#ifndef JUMP_H
+#define JUMP_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Function declarations
+void recordDirectoryVisit();
+bool runJump(const vector<string>& tokens);
+bool runPushd(const vector<string>& tokens);
+bool runPopd(const vector<string>& tokens);
+bool runDirs(const vector<string>& tokens);
+
+#endif // JUMP_H
@@ -0,0 +1,427 @@
+#include "limit.h"
+#include "shell.h"
+#include "vars.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+// ulimit options: the flag, the resource and the unit its values are given in
+struct LimitOption
+{
+    char flag;
+    int resource;
+    rlim_t unit;
+    const char* description;
+};
+
+static const LimitOption limitOptions[] = {
+    {'c', RLIMIT_CORE,    1024, "core file size (KiB)"},
+    {'d', RLIMIT_DATA,    1024, "data seg size (KiB)"},
+    {'f', RLIMIT_FSIZE,   1024, "file size (KiB)"},
+    {'l', RLIMIT_MEMLOCK, 1024, "max locked memory (KiB)"},
+    {'n', RLIMIT_NOFILE,  1,    "open files"},
+    {'s', RLIMIT_STACK,   1024, "stack size (KiB)"},
+    {'t', RLIMIT_CPU,     1,    "cpu time (seconds)"},
+    {'u', RLIMIT_NPROC,   1,    "max user processes"},
+    {'v', RLIMIT_AS,      1024, "virtual memory (KiB)"},
+};
+
+// Limits set with ulimit. They are applied to each command between fork and exec,
+// so lowering one never constrains the shell itself, and a lowered hard limit can be raised again
+static map<int, rlimit> jobLimits;
+
+static const LimitOption* findOption(char flag)
+{
+    for (const auto& option : limitOptions)
+    {
+        if (option.flag == flag)
+            return &option;
+    }
+    return nullptr;
+}
+
+// Function to get the limit commands will run with
+static rlimit effectiveLimit(int resource)
+{
+    auto found = jobLimits.find(resource);
+    if (found != jobLimits.end())
+        return found->second;
+    rlimit limit;
+    getrlimit(resource, &limit);
+    return limit;
+}
+
+static string formatLimit(rlim_t value, rlim_t unit)
+{
+    return value == RLIM_INFINITY ? "unlimited" : to_string(value / unit);
+}
+
+// Function to set the ulimit limits in a child that is about to exec
+void applyJobLimits()
+{
+    for (const auto& entry : jobLimits)
+    {
+        if (setrlimit(entry.first, &entry.second) != 0)
+            perror("ulimit");
+    }
+}
+
+// Function to get the limits set with ulimit, for commands the zygote starts
+const map<int, rlimit>& currentJobLimits()
+{
+    return jobLimits;
+}
+
+// Function to implement `ulimit [-S|-H] [-a | -c|-d|-f|-l|-n|-s|-t|-u|-v [value|unlimited]]`
+bool runUlimit(vector<string>& tokens)
+{
+    bool softOnly = false, hardOnly = false, all = false;
+    const LimitOption* option = nullptr;
+    string value;
+    for (size_t i = 1; i < tokens.size(); i++)
+    {
+        const string& word = tokens[i];
+        if (word.size() >= 2 && word[0] == '-')
+        {
+            for (size_t j = 1; j < word.size(); j++)
+            {
+                if (word[j] == 'S')
+                    softOnly = true;
+                else if (word[j] == 'H')
+                    hardOnly = true;
+                else if (word[j] == 'a')
+                    all = true;
+                else if ((option = findOption(word[j])) == nullptr)
+                {
+                    cerr << "ulimit: -" << word[j] << ": unknown option" << endl;
+                    return false;
+                }
+            }
+        }
+        else if (value.empty())
+            value = word;
+        else
+        {
+            cerr << "ulimit: too many arguments" << endl;
+            return false;
+        }
+    }
+
+    if (all)
+    {
+        for (const auto& entry : limitOptions)
+        {
+            rlimit limit = effectiveLimit(entry.resource);
+            cout << left << setw(28) << entry.description << "(-" << entry.flag << ") "
+                 << formatLimit(hardOnly ? limit.rlim_max : limit.rlim_cur, entry.unit) << endl;
+        }
+        return true;
+    }
+    if (option == nullptr)
+        option = findOption('f');
+
+    rlimit limit = effectiveLimit(option->resource);
+    if (value.empty())
+    {
+        cout << formatLimit(hardOnly ? limit.rlim_max : limit.rlim_cur, option->unit) << endl;
+        return true;
+    }
+
+    rlim_t newValue = RLIM_INFINITY;
+    if (value != "unlimited")
+    {
+        char* end;
+        errno = 0;
+        unsigned long long number = strtoull(value.c_str(), &end, 10);
+        if (value[0] == '-' || *end != '\0' || errno != 0 || number >= RLIM_INFINITY / option->unit)
+        {
+            cerr << "ulimit: " << value << ": invalid limit" << endl;
+            return false;
+        }
+        newValue = number * option->unit;
+    }
+
+    // Like bash, a new value sets both limits unless -S or -H picks one
+    if (!hardOnly)
+        limit.rlim_cur = newValue;
+    if (!softOnly)
+        limit.rlim_max = newValue;
+    if (limit.rlim_cur > limit.rlim_max)
+    {
+        cerr << "ulimit: soft limit exceeds the hard limit" << endl;
+        return false;
+    }
+
+    // Try the limit in a throwaway child: raising a hard limit, or going past a kernel
+    // ceiling such as fs.nr_open, would otherwise only fail in every command started later
+    pid_t pid = fork();
+    if (pid == 0)
+        _exit(setrlimit(option->resource, &limit) == 0 ? 0 : errno);
+    int commstatus = 0;
+    while (pid > 0 && waitpid(pid, &commstatus, 0) < 0 && errno == EINTR)
+        ;
+    if (pid < 0 || !WIFEXITED(commstatus) || WEXITSTATUS(commstatus) != 0)
+    {
+        cerr << "ulimit: " << value << ": " << strerror(pid < 0 ? errno : WEXITSTATUS(commstatus)) << endl;
+        return false;
+    }
+    jobLimits[option->resource] = limit;
+    return true;
+}
+
+// Function to parse a size such as 4096, 512K, 512M or 2G (powers of 1024) into bytes, or 0 if malformed
+static unsigned long long parseSize(const string& text)
+{
+    char* end;
+    double value = strtod(text.c_str(), &end);
+    if (end == text.c_str() || value <= 0)
+        return 0;
+    string suffix = end;
+    const string units = "KMGT";
+    if (suffix.size() == 1 && units.find(toupper(suffix[0])) != string::npos)
+    {
+        for (size_t i = 0; i <= units.find(toupper(suffix[0])); i++)
+            value *= 1024;
+    }
+    else if (!suffix.empty())
+        return 0;
+    return (unsigned long long)value;
+}
+
+// Function to parse a CPU share such as 150% or 1.5 into a number of CPUs, or 0 if malformed
+static double parseCpu(const string& text)
+{
+    char* end;
+    double value = strtod(text.c_str(), &end);
+    if (end == text.c_str())
+        return 0;
+    if (*end == '%')
+    {
+        value /= 100;
+        end++;
+    }
+    // cpu.max accepts no quota below 1ms per 100ms period
+    return *end == '\0' && value >= 0.01 ? value : 0;
+}
+
+static string formatSize(unsigned long long bytes)
+{
+    const char* units[] = {"B", "K", "M", "G", "T"};
+    double value = bytes;
+    int unit = 0;
+    while (value >= 1024 && unit < 4)
+    {
+        value /= 1024;
+        unit++;
+    }
+    char text[32];
+    snprintf(text, sizeof(text), unit == 0 ? "%.0f%s" : "%.1f%s", value, units[unit]);
+    return text;
+}
+
+static bool writeFile(const string& path, const string& text)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    ssize_t written = write(fd, text.data(), text.size());
+    close(fd);
+    return written == (ssize_t)text.size();
+}
+
+// Function to read the value after key in a flat-keyed cgroup file such as cpu.stat,
+// or the file's only number when key is empty; -1 if it is missing
+static long long readCgroupValue(const string& path, const string& key)
+{
+    ifstream file(path);
+    string name;
+    long long value;
+    if (key.empty())
+        return file >> value ? value : -1;
+    while (file >> name >> value)
+    {
+        if (name == key)
+            return value;
+    }
+    return -1;
+}
+
+// Function to find where the cgroup-v2 hierarchy is mounted, or "" on a v1-only host
+static string cgroupMount()
+{
+    ifstream mounts("/proc/self/mountinfo");
+    string line;
+    while (getline(mounts, line))
+    {
+        // id parent dev root mountpoint options... - fstype source options
+        size_t dash = line.find(" - ");
+        if (dash == string::npos || line.compare(dash + 3, 8, "cgroup2 ") != 0)
+            continue;
+        istringstream fields(line);
+        string id, parent, device, root, mountPoint;
+        fields >> id >> parent >> device >> root >> mountPoint;
+        return mountPoint;
+    }
+    return "";
+}
+
+// Function to find the cgroup jobs are created under: $LIMIT_CGROUP, else the shell's own
+static string parentCgroup()
+{
+    const string* configured = lookupVariable("LIMIT_CGROUP");
+    if (configured != nullptr && !configured->empty())
+        return *configured;
+    string mountPoint = cgroupMount();
+    if (mountPoint.empty())
+        return "";
+    ifstream self("/proc/self/cgroup");
+    string line;
+    while (getline(self, line))
+    {
+        if (line.compare(0, 3, "0::") == 0)
+            return mountPoint + line.substr(3);
+    }
+    return "";
+}
+
+// Function to create a cgroup for one job with the given caps, or "" if no delegated subtree allows it
+static string createJobCgroup(unsigned long long memory, double cpus)
+{
+    string parent = parentCgroup();
+    if (parent.empty())
+        return "";
+
+    // Children only get a controller the parent enables for them. The kernel refuses that for
+    // a cgroup that still holds processes (such as the shell's own), hence $LIMIT_CGROUP
+    vector<string> needed;
+    if (memory != 0)
+        needed.push_back("memory");
+    if (cpus != 0)
+        needed.push_back("cpu");
+    ifstream control(parent + "/cgroup.subtree_control");
+    string enabled;
+    getline(control, enabled);
+    enabled = " " + enabled + " ";
+    for (const string& controller : needed)
+    {
+        if (enabled.find(" " + controller + " ") == string::npos && !writeFile(parent + "/cgroup.subtree_control", "+" + controller))
+            return "";
+    }
+
+    string path = parent + "/cc-limit-" + to_string(getpid());
+    if (mkdir(path.c_str(), 0755) != 0)
+        return "";
+    bool ok = true;
+    if (memory != 0)
+        ok = writeFile(path + "/memory.max", to_string(memory));
+    if (ok && cpus != 0)
+        ok = writeFile(path + "/cpu.max", to_string((long long)(cpus * 100000)) + " 100000");
+    if (!ok)
+    {
+        rmdir(path.c_str());
+        return "";
+    }
+    return path;
+}
+
+// Function to print what the job used: peak memory, and with a cgroup, CPU throttling and OOM kills
+static void reportUsage(const string& cgroup, const rusage& usage)
+{
+    unsigned long long peak = usage.ru_maxrss * 1024ULL;
+    string report;
+    if (!cgroup.empty())
+    {
+        // memory.peak covers the whole job, ru_maxrss only its biggest process
+        long long cgroupPeak = readCgroupValue(cgroup + "/memory.peak", "");
+        if (cgroupPeak > 0)
+            peak = cgroupPeak;
+        long long throttled = readCgroupValue(cgroup + "/cpu.stat", "nr_throttled");
+        long long throttledUsec = readCgroupValue(cgroup + "/cpu.stat", "throttled_usec");
+        if (throttled > 0)
+        {
+            char seconds[32];
+            snprintf(seconds, sizeof(seconds), "%.2fs", throttledUsec / 1e6);
+            report += ", throttled " + to_string(throttled) + " times for " + seconds;
+        }
+        long long oomKills = readCgroupValue(cgroup + "/memory.events", "oom_kill");
+        if (oomKills > 0)
+            report += ", " + to_string(oomKills) + " killed for memory";
+    }
+    cerr << "limit: peak memory " << formatSize(peak) << report << endl;
+}
+
+// Function to implement `limit [--mem SIZE] [--cpu SHARE] cmd`: run cmd in its own cgroup
+// with memory.max and cpu.max set, or under rlimits when no cgroup is delegated
+bool runLimit(vector<string>& tokens, BuiltinContext& context)
+{
+    unsigned long long memory = 0;
+    double cpus = 0;
+    size_t i = 1;
+    for (; i + 1 < tokens.size() && tokens[i] != "--" && tokens[i].compare(0, 2, "--") == 0; i += 2)
+    {
+        if (tokens[i] == "--mem" && (memory = parseSize(tokens[i + 1])) != 0)
+            continue;
+        if (tokens[i] == "--cpu" && (cpus = parseCpu(tokens[i + 1])) != 0)
+            continue;
+        cerr << "limit: bad option " << tokens[i] << " " << tokens[i + 1] << endl;
+        return false;
+    }
+    if (i < tokens.size() && tokens[i] == "--")
+        i++;
+    if (i >= tokens.size() || (memory == 0 && cpus == 0))
+    {
+        cerr << "limit: usage: limit [--mem SIZE] [--cpu SHARE] command" << endl;
+        return false;
+    }
+    vector<string> command(tokens.begin() + i, tokens.end());
+
+    string cgroup = createJobCgroup(memory, cpus);
+    if (cgroup.empty() && cpus != 0)
+        cerr << "limit: no delegated cgroup, --cpu is not enforced" << endl;
+
+    cout.flush();
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror("limit: fork");
+        if (!cgroup.empty())
+            rmdir(cgroup.c_str());
+        return false;
+    }
+    if (pid == 0)
+    {
+        // The child moves itself before exec, so everything the job starts is accounted too
+        if (cgroup.empty() || !writeFile(cgroup + "/cgroup.procs", "0"))
+        {
+            if (!cgroup.empty() && cpus != 0)
+                cerr << "limit: cannot join " << cgroup << ", --cpu is not enforced" << endl;
+            // The nearest rlimit: private writable memory (heap, anonymous maps, stack)
+            rlimit limit = {memory, memory};
+            if (memory != 0 && setrlimit(RLIMIT_DATA, &limit) != 0)
+                perror("limit");
+        }
+        _exit(runWords(command, context));
+    }
+
+    int commstatus;
+    rusage usage;
+    while (wait4(pid, &commstatus, 0, &usage) < 0 && errno == EINTR)
+        ;
+    lastExitStatus = WIFEXITED(commstatus) ? WEXITSTATUS(commstatus) : 128 + WTERMSIG(commstatus);
+    reportUsage(cgroup, usage);
+    if (!cgroup.empty())
+        rmdir(cgroup.c_str()); // Fails only if the job left processes behind
+    return true;
+}
@@ -0,0 +1,18 @@
+#ifndef LIMIT_H
+#define LIMIT_H
+
+#include "builtins.h"
+#include <map>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+using namespace std;
+
+// Function declarations
+bool runUlimit(vector<string>& tokens);
+bool runLimit(vector<string>& tokens, BuiltinContext& context);
+void applyJobLimits();
+const map<int, rlimit>& currentJobLimits();
+
+#endif // LIMIT_H
@@ -0,0 +1,456 @@
+#include "lineedit.h"
+#include "complete.h"
+#include <iostream>
+#include <vector>
+#include <cerrno>
+#include <cctype>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+
+using namespace std;
+
+// Everything the editor knows about the line being edited and about what is
+// currently on the screen. Rendering compares the two and only emits the change
+struct LineEditor
+{
+    string prompt;
+    size_t promptWidth; // Visible columns of the prompt
+    int columns;        // Terminal width
+
+    string line;        // The buffer being edited
+    size_t cursor;      // Index into line
+
+    string shown;       // What is rendered after the prompt right now
+    size_t shownCursor; // Where the terminal cursor is, as an index into shown
+
+    string killRing;    // Last text removed by CTRL-K/U/W or ALT-D
+    bool listed;        // A second Tab lists the candidates
+
+    const vector<string>* history;
+    size_t historyIndex; // history->size() means the line being typed
+    string pending;      // The line being typed while browsing history
+};
+
+static void writeOut(const string& text)
+{
+    size_t done = 0;
+    while (done < text.size())
+    {
+        ssize_t n = write(STDOUT_FILENO, text.data() + done, text.size() - done);
+        if (n <= 0 && errno != EINTR)
+            return;
+        if (n > 0)
+            done += n;
+    }
+}
+
+// Function to count the columns a prompt takes, skipping escape sequences
+static size_t visibleWidth(const string& text)
+{
+    size_t width = 0;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        if (text[i] == '\x1b')
+        {
+            while (i < text.size() && !isalpha((unsigned char)text[i]))
+                i++;
+            continue;
+        }
+        if ((text[i] & 0xC0) != 0x80) // Count UTF-8 lead bytes only
+            width++;
+    }
+    return width;
+}
+
+static int terminalColumns()
+{
+    struct winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0)
+        return size.ws_col;
+    return 80;
+}
+
+// Function to append the escape sequences moving the cursor between two line
+// indexes, accounting for rows the line wraps onto
+static void moveCursor(const LineEditor& editor, string& out, size_t from, size_t to)
+{
+    size_t fromOffset = editor.promptWidth + from;
+    size_t toOffset = editor.promptWidth + to;
+    size_t fromRow = fromOffset / editor.columns, fromCol = fromOffset % editor.columns;
+    size_t toRow = toOffset / editor.columns, toCol = toOffset % editor.columns;
+
+    if (toRow < fromRow)
+        out += "\x1b[" + to_string(fromRow - toRow) + "A";
+    else if (toRow > fromRow)
+        out += "\x1b[" + to_string(toRow - fromRow) + "B";
+    if (toCol < fromCol)
+        out += "\x1b[" + to_string(fromCol - toCol) + "D";
+    else if (toCol > fromCol)
+        out += "\x1b[" + to_string(toCol - fromCol) + "C";
+}
+
+// Function to bring the screen in line with the buffer: skip the unchanged
+// prefix, rewrite only the tail that differs and clear what is left over
+static void render(LineEditor& editor, string& out)
+{
+    size_t common = 0;
+    while (common < editor.shown.size() && common < editor.line.size() && editor.shown[common] == editor.line[common])
+        common++;
+
+    if (common == editor.shown.size() && common == editor.line.size())
+    {
+        moveCursor(editor, out, editor.shownCursor, editor.cursor);
+        editor.shownCursor = editor.cursor;
+        return;
+    }
+
+    // On a single row a pure insertion or deletion in the middle can use the
+    // terminal's insert/delete character sequences instead of rewriting the tail
+    size_t suffix = 0;
+    while (suffix < editor.shown.size() - common && suffix < editor.line.size() - common &&
+           editor.shown[editor.shown.size() - 1 - suffix] == editor.line[editor.line.size() - 1 - suffix])
+        suffix++;
+    size_t removed = editor.shown.size() - common - suffix;
+    size_t inserted = editor.line.size() - common - suffix;
+    bool oneRow = editor.promptWidth + max(editor.line.size(), editor.shown.size()) < (size_t)editor.columns;
+    if (oneRow && suffix > 0 && (removed == 0 || inserted == 0))
+    {
+        moveCursor(editor, out, editor.shownCursor, common);
+        if (removed > 0)
+        {
+            out += "\x1b[" + to_string(removed) + "P";
+        }
+        else
+        {
+            out += "\x1b[" + to_string(inserted) + "@";
+            out.append(editor.line, common, inserted);
+        }
+        moveCursor(editor, out, common + inserted, editor.cursor);
+        editor.shown = editor.line;
+        editor.shownCursor = editor.cursor;
+        return;
+    }
+
+    moveCursor(editor, out, editor.shownCursor, common);
+    out.append(editor.line, common, string::npos);
+    if (editor.line.size() < editor.shown.size())
+        out += "\x1b[J";
+
+    // A line ending exactly at the right margin leaves the cursor in the
+    // terminal's pending-wrap state; step onto the next row explicitly
+    size_t end = editor.line.size();
+    if (end > common && (editor.promptWidth + end) % editor.columns == 0)
+        out += "\n";
+
+    moveCursor(editor, out, end, editor.cursor);
+    editor.shown = editor.line;
+    editor.shownCursor = editor.cursor;
+}
+
+// Function to forget the screen state after output that scrolled the line away
+static void redrawFromScratch(LineEditor& editor, string& out)
+{
+    out += editor.prompt;
+    editor.shown.clear();
+    editor.shownCursor = 0;
+}
+
+static bool isWordChar(char c)
+{
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+static size_t previousWord(const string& line, size_t pos)
+{
+    while (pos > 0 && !isWordChar(line[pos - 1]))
+        pos--;
+    while (pos > 0 && isWordChar(line[pos - 1]))
+        pos--;
+    return pos;
+}
+
+static size_t nextWord(const string& line, size_t pos)
+{
+    while (pos < line.size() && !isWordChar(line[pos]))
+        pos++;
+    while (pos < line.size() && isWordChar(line[pos]))
+        pos++;
+    return pos;
+}
+
+static void showHistoryEntry(LineEditor& editor, size_t index)
+{
+    if (editor.historyIndex == editor.history->size())
+        editor.pending = editor.line;
+    editor.historyIndex = index;
+    editor.line = index == editor.history->size() ? editor.pending : (*editor.history)[index];
+    editor.cursor = editor.line.size();
+}
+
+// Function to handle a Tab press: insert a unique completion, extend to the
+// common prefix, or list every candidate on the second press
+static void handleTab(LineEditor& editor, string& out)
+{
+    size_t wordStart;
+    vector<string> matches = completeWord(editor.line, editor.cursor, wordStart);
+    if (matches.empty())
+    {
+        out += "\a";
+        return;
+    }
+
+    size_t typed = editor.cursor - wordStart;
+    string common = commonPrefix(matches);
+    if (matches.size() == 1 || common.size() > typed)
+    {
+        string addition = common.substr(typed);
+        if (matches.size() == 1 && common[common.size() - 1] != '/')
+            addition += ' ';
+        editor.line.insert(editor.cursor, addition);
+        editor.cursor += addition.size();
+        return;
+    }
+    if (!editor.listed)
+    {
+        out += "\a";
+        editor.listed = true;
+        return;
+    }
+
+    moveCursor(editor, out, editor.shownCursor, editor.shown.size());
+    out += "\n";
+    for (auto& match : matches)
+        out += match + "  ";
+    out += "\n";
+    redrawFromScratch(editor, out);
+}
+
+// Function to read the rest of an escape sequence and map it to an action
+static char readEscape()
+{
+    char first;
+    if (read(STDIN_FILENO, &first, 1) != 1)
+        return 0;
+    if (first != '[' && first != 'O')
+        return isalpha((unsigned char)first) ? (char)(first | 0x80) : 0; // ALT-key
+    char c;
+    string params;
+    while (read(STDIN_FILENO, &c, 1) == 1)
+    {
+        if (isdigit((unsigned char)c) || c == ';')
+        {
+            params += c;
+            continue;
+        }
+        if (c == '~')
+        {
+            if (params == "1" || params == "7")
+                return 'H';
+            if (params == "4" || params == "8")
+                return 'F';
+            if (params == "3")
+                return 'X'; // Delete
+            return 0;
+        }
+        return c; // A B C D H F
+    }
+    return 0;
+}
+
+// Function to apply one key to the editor; returns 1 on Enter, -1 on end of input
+static int handleKey(LineEditor& editor, char c, string& out)
+{
+    string& line = editor.line;
+    size_t& cursor = editor.cursor;
+
+    if (c != '\t')
+        editor.listed = false;
+
+    if (c == '\x1b')
+    {
+        char action = readEscape();
+        switch (action)
+        {
+            case 'A': c = 16; break; // Up is CTRL-P
+            case 'B': c = 14; break; // Down is CTRL-N
+            case 'C': c = 6; break;  // Right is CTRL-F
+            case 'D': c = 2; break;  // Left is CTRL-B
+            case 'H': c = 1; break;  // Home is CTRL-A
+            case 'F': c = 5; break;  // End is CTRL-E
+            case 'X':
+                if (cursor < line.size())
+                    line.erase(cursor, 1);
+                return 0;
+            case (char)('b' | 0x80):
+                cursor = previousWord(line, cursor);
+                return 0;
+            case (char)('f' | 0x80):
+                cursor = nextWord(line, cursor);
+                return 0;
+            case (char)('d' | 0x80):
+            {
+                size_t end = nextWord(line, cursor);
+                editor.killRing = line.substr(cursor, end - cursor);
+                line.erase(cursor, end - cursor);
+                return 0;
+            }
+            default:
+                return 0;
+        }
+    }
+
+    switch (c)
+    {
+        case '\r':
+        case '\n':
+            cursor = line.size();
+            render(editor, out);
+            out += "\n";
+            return 1;
+        case 1: // CTRL-A
+            cursor = 0;
+            break;
+        case 5: // CTRL-E
+            cursor = line.size();
+            break;
+        case 2: // CTRL-B
+            if (cursor > 0)
+                cursor--;
+            break;
+        case 6: // CTRL-F
+            if (cursor < line.size())
+                cursor++;
+            break;
+        case 4: // CTRL-D: delete under the cursor, or log out on an empty line
+            if (line.empty())
+                return -1;
+            if (cursor < line.size())
+                line.erase(cursor, 1);
+            break;
+        case 127:
+        case 8: // Backspace
+            if (cursor > 0)
+                line.erase(--cursor, 1);
+            break;
+        case 11: // CTRL-K
+            editor.killRing = line.substr(cursor);
+            line.erase(cursor);
+            break;
+        case 21: // CTRL-U
+            editor.killRing = line.substr(0, cursor);
+            line.erase(0, cursor);
+            cursor = 0;
+            break;
+        case 23: // CTRL-W
+        {
+            size_t start = previousWord(line, cursor);
+            editor.killRing = line.substr(start, cursor - start);
+            line.erase(start, cursor - start);
+            cursor = start;
+            break;
+        }
+        case 25: // CTRL-Y
+            line.insert(cursor, editor.killRing);
+            cursor += editor.killRing.size();
+            break;
+        case 20: // CTRL-T
+            if (cursor > 0 && line.size() > 1)
+            {
+                if (cursor == line.size())
+                    cursor--;
+                swap(line[cursor - 1], line[cursor]);
+                cursor++;
+            }
+            break;
+        case 12: // CTRL-L
+            out += "\x1b[H\x1b[2J";
+            redrawFromScratch(editor, out);
+            break;
+        case 16: // CTRL-P
+            if (editor.historyIndex > 0)
+                showHistoryEntry(editor, editor.historyIndex - 1);
+            break;
+        case 14: // CTRL-N
+            if (editor.historyIndex < editor.history->size())
+                showHistoryEntry(editor, editor.historyIndex + 1);
+            break;
+        case '\t':
+            handleTab(editor, out);
+            break;
+        default:
+            if ((unsigned char)c >= 32)
+                line.insert(cursor++, 1, c);
+            break;
+    }
+    return 0;
+}
+
+// Function to read one line; returns false on end of input. Terminals get a
+// raw-mode editor with Emacs keys, history and Tab completion, anything else plain getline
+bool readLine(const string& prompt, string& line, const vector<string>& history)
+{
+    line.clear();
+    if (!isatty(STDIN_FILENO))
+    {
+        cout << prompt;
+        getline(cin, line);
+        return !cin.eof();
+    }
+
+    cout << prompt << flush;
+    struct termios original, raw;
+    tcgetattr(STDIN_FILENO, &original);
+    raw = original;
+    raw.c_lflag &= ~(ICANON | ECHO | IEXTEN);
+    raw.c_iflag &= ~(IXON | ICRNL);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    // TCSAFLUSH would drop keys typed ahead while the last command ran
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &raw);
+
+    LineEditor editor;
+    editor.prompt = prompt;
+    editor.promptWidth = visibleWidth(prompt);
+    editor.columns = terminalColumns();
+    editor.cursor = 0;
+    editor.shownCursor = 0;
+    editor.listed = false;
+    editor.history = &history;
+    editor.historyIndex = history.size();
+
+    int result = 0;
+    while (result == 0)
+    {
+        char c;
+        ssize_t n = read(STDIN_FILENO, &c, 1);
+        string out;
+        if (n < 0 && errno == EINTR)
+        {
+            // CTRL-C at the prompt abandons the line
+            moveCursor(editor, out, editor.shownCursor, editor.shown.size());
+            out += "^C\n";
+            editor.line.clear();
+            editor.cursor = 0;
+            editor.historyIndex = history.size();
+            redrawFromScratch(editor, out);
+            writeOut(out);
+            continue;
+        }
+        if (n <= 0)
+        {
+            result = -1;
+            break;
+        }
+
+        result = handleKey(editor, c, out);
+        if (result == 0)
+            render(editor, out);
+        writeOut(out); // One write per keystroke
+    }
+
+    // Keys typed after Enter belong to the command about to run
+    tcsetattr(STDIN_FILENO, TCSANOW, &original);
+    line = editor.line;
+    return result == 1;
+}
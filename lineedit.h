@@ -0,0 +1,12 @@
+#ifndef LINEEDIT_H
+#define LINEEDIT_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Function declarations
+bool readLine(const string& prompt, string& line, const vector<string>& history);
+
+#endif // LINEEDIT_H
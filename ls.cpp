@@ -9,8 +9,95 @@
 
 using namespace std;
 
+// Function to print one entry in long format: mode, links, owner, group, size, time and name
+static void printLongEntry(const struct stat& info, const string& name)
+{
+    if (S_ISDIR(info.st_mode))
+        cout << "d";
+    else
+        cout << "-";
+
+    if (info.st_mode & S_IRUSR)
+        cout << "r";
+    else
+        cout << "-";
+
+    if (info.st_mode & S_IWUSR)
+        cout << "w";
+    else
+        cout << "-";
+
+    if (info.st_mode & S_IXUSR)
+        cout << "x";
+    else
+        cout << "-";
+
+    if (info.st_mode & S_IRGRP)
+        cout << "r";
+    else
+        cout << "-";
+
+    if (info.st_mode & S_IWGRP)
+        cout << "w";
+    else
+        cout << "-";
+
+    if (info.st_mode & S_IXGRP)
+        cout << "x";
+    else
+        cout << "-";
+
+    if (info.st_mode & S_IROTH)
+        cout << "r";
+    else
+        cout << "-";
+
+    if (info.st_mode & S_IWOTH)
+        cout << "w";
+    else
+        cout << "-";
+
+    if (info.st_mode & S_IXOTH)
+        cout << "x";
+    else
+        cout << "-";
+
+    cout << " " << info.st_nlink;
+
+    struct passwd *pw = getpwuid(info.st_uid);
+    struct group *gr = getgrgid(info.st_gid);
+    if (pw)
+        cout << " " << pw->pw_name;
+    else
+        cout << " ";
+
+    if (gr)
+        cout << " " << gr->gr_name;
+    else
+        cout << " ";
+
+    cout << " " << setw(8) << info.st_size;
+
+    char timebuffer[80];
+    strftime(timebuffer, sizeof(timebuffer), "%b %d %H:%M", localtime(&info.st_mtime));
+    cout << " " << timebuffer;
+
+    cout << " " << name << endl;
+}
+
 bool listing(string& path, bool all, bool longformat)
 {
+    // A file operand, such as a match of `ls *.log`, lists just itself
+    struct stat operand;
+    if (stat(path.c_str(), &operand) == 0 && !S_ISDIR(operand.st_mode))
+    {
+        if (longformat)
+            printLongEntry(operand, path);
+        else
+            cout << path << endl;
+        return true;
+    }
+
     DIR *dir = opendir(path.c_str());
 
     if(!dir)
@@ -36,77 +123,7 @@ bool listing(string& path, bool all, bool longformat)
                 closedir(dir);
                 return false;
             }
-            if (S_ISDIR(info.st_mode))
-                cout << "d";
-            else
-                cout << "-";
-
-            if (info.st_mode & S_IRUSR)
-                cout << "r";
-            else
-                cout << "-";
-
-            if (info.st_mode & S_IWUSR)
-                cout << "w";
-            else
-                cout << "-";
-
-            if (info.st_mode & S_IXUSR)
-                cout << "x";
-            else
-                cout << "-";
-
-            if (info.st_mode & S_IRGRP)
-                cout << "r";
-            else
-                cout << "-";
-
-            if (info.st_mode & S_IWGRP)
-                cout << "w";
-            else
-                cout << "-";
-
-            if (info.st_mode & S_IXGRP)
-                cout << "x";
-            else
-                cout << "-";
-
-            if (info.st_mode & S_IROTH)
-                cout << "r";
-            else
-                cout << "-";
-
-            if (info.st_mode & S_IWOTH)
-                cout << "w";
-            else
-                cout << "-";
-
-            if (info.st_mode & S_IXOTH)
-                cout << "x";
-            else
-                cout << "-";
-
-            cout << " " << info.st_nlink;
-
-            struct passwd *pw = getpwuid(info.st_uid);
-            struct group *gr = getgrgid(info.st_gid);
-            if (pw)
-                cout << " " << pw->pw_name;
-            else
-                cout << " ";
-
-            if (gr)
-                cout << " " << gr->gr_name;
-            else
-                cout << " ";
-
-            cout << " " << setw(8) << info.st_size;
-
-            char timebuffer[80];
-            strftime(timebuffer, sizeof(timebuffer), "%b %d %H:%M", localtime(&info.st_mtime));
-            cout << " " << timebuffer;
-
-            cout << " " << name << endl;
+            printLongEntry(info, name);
         }
         else
             cout << name << endl;
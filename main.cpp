@@ -2,19 +2,22 @@
 #include <unistd.h>
 #include <limits.h>
 #include <string>
-#include <pwd.h>
 #include <sys/types.h>
-#include <sys/utsname.h>
 #include <sys/wait.h>
 #include <signal.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <algorithm>
 #include "shell.h"
 #include "history.h"
+#include "record.h"
+#include "lineedit.h"
+#include "prompt.h"
+#include "server.h"
+#include "zygote.h"
 
 using namespace std;
 
-// Global variable to track the foreground process ID
-pid_t foregroundPid = -1;
-
 // Function to get the current working directory
 string getCurrentDirectory() 
 {
@@ -30,48 +33,6 @@ string getCurrentDirectory()
     }
 }
 
-// Function to get the username
-string getUserName() 
-{
-    struct passwd *pw;
-
-    if ((pw = getpwuid(geteuid())) != nullptr) 
-    {
-        return string(pw->pw_name);
-    } 
-    else 
-    {
-        perror("getpwuid() error");
-        return "";
-    }
-}
-
-// Function to get the system name
-string getSystemName() 
-{
-    struct utsname buffer;
-
-    if (uname(&buffer) != 0) {
-        perror("uname");
-        return "";
-    }
-
-    return string(buffer.sysname);
-}
-
-// Function to format and display the shell prompt
-void displayPrompt(const string& baseDir, string& currentDir) 
-{
-    string relativeDir = currentDir;
-
-    if (currentDir.find(baseDir) == 0) 
-    {
-        relativeDir = "~" + currentDir.substr(baseDir.length());
-    }
-
-    cout << getUserName() << "@" << getSystemName() << ":" << relativeDir << "> ";
-}
-
 // Signal handler for SIGTSTP (CTRL-Z)
 void handleSigTSTP(int sig) 
 {
@@ -108,118 +69,171 @@ void setupSignalHandlers()
     sigaction(SIGINT, &saINT, NULL);
 }
 
-int main() 
+// Per-command measurements taken while replaying a session log
+struct ReplaySample
+{
+    uint64_t wallUs;
+    uint64_t shellCpuUs;
+    int exitStatus;
+};
+
+// Function to read the shell's own user+system CPU time in microseconds
+uint64_t shellCpuUs()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+           usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+// Function to print the per-command overhead table and a summary for a replay
+void reportReplay(const vector<SessionRecord>& records, const vector<ReplaySample>& samples)
 {
+    vector<uint64_t> overheads;
+    uint64_t totalWall = 0, totalCpu = 0;
+    int mismatches = 0;
+
+    cerr << "#\trecorded_us\twall_us\tshell_cpu_us\tstatus\tcommand" << endl;
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        const ReplaySample& sample = samples[i];
+        bool mismatch = sample.exitStatus != records[i].exitStatus;
+        cerr << i + 1 << "\t" << records[i].durationUs << "\t" << sample.wallUs << "\t"
+             << sample.shellCpuUs << "\t" << sample.exitStatus << (mismatch ? "!" : "") << "\t"
+             << records[i].line << endl;
+
+        overheads.push_back(sample.shellCpuUs);
+        totalWall += sample.wallUs;
+        totalCpu += sample.shellCpuUs;
+        if (mismatch)
+            mismatches++;
+    }
+    if (overheads.empty())
+        return;
+
+    sort(overheads.begin(), overheads.end());
+    cerr << "commands " << samples.size() << ", wall " << totalWall << " us, shell cpu " << totalCpu
+         << " us (mean " << totalCpu / samples.size() << ", p50 " << overheads[overheads.size() / 2]
+         << ", p99 " << overheads[overheads.size() * 99 / 100] << "), status mismatches " << mismatches << endl;
+}
+
+int main(int argc, char* argv[]) 
+{
+    string recordPath, replayPath, serverPath, connectPath;
+    bool paced = false;
+    int serverThreads = 8;
+    for (int i = 1; i < argc; i++) 
+    {
+        string arg = argv[i];
+        if (arg == "--record" && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc)
+            replayPath = argv[++i];
+        else if (arg == "--paced")
+            paced = true;
+        else if (arg == "--server" && i + 1 < argc)
+            serverPath = argv[++i];
+        else if (arg == "--threads" && i + 1 < argc && atoi(argv[i + 1]) > 0)
+            serverThreads = atoi(argv[++i]);
+        else if (arg == "--connect" && i + 1 < argc)
+            connectPath = argv[++i];
+        else 
+        {
+            cerr << "usage: " << argv[0] << " [--record FILE] [--replay FILE [--paced]] [--server SOCKET [--threads N]] [--connect SOCKET]" << endl;
+            return 1;
+        }
+    }
+
+    // A client only hands its terminal to the server
+    if (!connectPath.empty())
+        return runClient(connectPath);
+
+    // The zygote is forked while the shell is still small; server sessions fork their own children
+    if (serverPath.empty())
+        startZygote();
+
+    // Replay mode feeds a recorded session through the same loop as typed input
+    vector<SessionRecord> replayRecords;
+    vector<ReplaySample> replaySamples;
+    bool replaying = !replayPath.empty();
+    if (replaying) 
+    {
+        if (!readSessionLog(replayPath, replayRecords))
+            return 1;
+        if (!replayRecords.empty() && chdir(replayRecords[0].cwd.c_str()) != 0)
+            perror("replay: cannot enter recorded directory");
+    }
+    if (!recordPath.empty() && !openSessionLog(recordPath))
+        return 1;
+
     string baseDir = getCurrentDirectory(); // The directory where the shell was started
     vector<string> history;
     loadHistory(history);
+    initPrompt(baseDir); // User and system name are looked up once, here
+
+    if (!serverPath.empty())
+        return runServer(serverPath, serverThreads, baseDir, history);
 
     int status = 1;
+    size_t replayIndex = 0;
+    uint64_t replayStartUs = wallClockUs();
 
     setupSignalHandlers(); // Set up signal handlers
 
     while (status) 
     {
-        string currentDir = getCurrentDirectory();
-        // Display the prompt
-        displayPrompt(baseDir, currentDir);
+        string currentDir = promptCurrentDirectory();
 
         // Read user input
         string input;
-        getline(cin, input);
-
-        if(cin.eof())
+        if (replaying) 
+        {
+            if (replayIndex == replayRecords.size())
+                break;
+            const SessionRecord& record = replayRecords[replayIndex++];
+            if (paced) 
+            {
+                // Sleep until the line's offset from the start of the recording
+                uint64_t due = replayStartUs + (record.startUs - replayRecords[0].startUs);
+                uint64_t now = wallClockUs();
+                if (due > now)
+                    usleep(due - now);
+            }
+            input = record.line;
+        } 
+        else 
         {
-            cout << endl;
-            break;
+            // Display the prompt and read a line, with editing and completion on a terminal
+            if (!readLine(renderPrompt(), input, history))
+            {
+                cout << endl;
+                break;
+            }
         }
 
-        // Tokenize by semicolon first
-        vector<string> commandList = tokenizeBySemicolon(input);
+        uint64_t startUs = wallClockUs();
+        uint64_t startCpu = shellCpuUs();
 
         addCommToHistory(input, history);
+        executeInputLine(input, baseDir, currentDir, history, status);
 
-        // Process each command in the command list (semicolon-separated)
-        for (long unsigned int i = 0; i < commandList.size(); i++) 
+        uint64_t durationUs = wallClockUs() - startUs;
+        promptCommandFinished(lastExitStatus, durationUs);
+        if (replaying) 
         {
-            string command = commandList[i];
-
-            // Tokenize by pipe for piped commands
-            vector<string> pipeCommands = tokenizeByPipe(command);
-
-            if (pipeCommands.size() > 1) 
-            {
-                // If the command contains pipes, handle the pipeline
-                vector<vector<string>> commandTokens;
-
-                // Tokenize each individual command in the pipeline
-                for (auto& cmd : pipeCommands) 
-                {
-                    commandTokens.push_back(tokenize(cmd));
-                }
-
-                // Execute the piped commands
-                if (!executePipeline(commandTokens, baseDir, currentDir, history, status)) 
-                {
-                    cerr << "Failed to execute pipeline" << endl;
-                }
-            } 
-            else 
-            {
-                // No pipe, treat it as a single command
-                vector<string> singleCommandTokens = tokenize(command);
-
-                // Check for built-in commands like `exit` before forking
-                if (singleCommandTokens[0] == "exit") 
-                {
-                    status = 0;
-                    break;
-                }
-                // Handle `cd` directly in the parent process
-                if (singleCommandTokens[0] == "cd") 
-                {
-                    // Execute `cd` in the parent process
-                    if (!executeCommand(singleCommandTokens, baseDir, currentDir, command, history, status)) 
-                    {
-                        cerr << "Failed to execute cd command" << endl;
-                    }
-                }
-
-                else 
-                {
-                    // Set the foreground process ID before executing
-                    foregroundPid = fork();
-                    if (foregroundPid == 0) 
-                    {
-                        // In child process
-                        if (singleCommandTokens[0] != "cd") 
-                        {
-                            if (!executeCommand(singleCommandTokens, baseDir, currentDir, command, history, status)) 
-                            {
-                                cerr << "Failed to execute command" << endl;
-                            }
-                        }
-                        exit(0); // Exit child process after execution
-                    } 
-                    else 
-                    {
-                        // In parent process, wait for the foreground process
-                        int commstatus;
-                        waitpid(foregroundPid, &commstatus, 0);
-                        foregroundPid = -1; // Reset foreground process ID
-                    }
-                }
-
-                if (status == 0) 
-                {
-                    break; // Exit the shell loop if `exit` was called
-                }
-            }
-        
+            ReplaySample sample = {durationUs, shellCpuUs() - startCpu, lastExitStatus};
+            replaySamples.push_back(sample);
+        }
+        if (!recordPath.empty()) 
+        {
+            SessionRecord record = {startUs, durationUs, lastExitStatus, currentDir, input};
+            recordCommand(record);
         }
-
     }
+
+    closeSessionLog();
+    if (replaying)
+        reportReplay(replayRecords, replaySamples);
     return 0;
     
 }
-    
\ No newline at end of file
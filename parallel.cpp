@@ -0,0 +1,317 @@
+#include "parallel.h"
+#include "shell.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <map>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+// State of one running (or finished but not yet printed) job
+struct ParallelJob
+{
+    size_t index;   // Position of the job's argument in the input
+    pid_t pid;
+    int outFd;      // Read end of the job's output pipe, -1 when ungrouped or drained
+    string output;  // Output collected so far in grouped mode
+    bool reaped;
+    int exitStatus;
+};
+
+// Function to build one job's argv from the template, replacing {} or appending the argument
+static vector<string> buildJobTokens(const vector<string>& templ, const string& arg)
+{
+    vector<string> tokens;
+    bool replaced = false;
+    for (auto& token : templ)
+    {
+        size_t pos = token.find("{}");
+        if (pos == string::npos)
+        {
+            tokens.push_back(token);
+            continue;
+        }
+        string expanded = token;
+        while (pos != string::npos)
+        {
+            expanded.replace(pos, 2, arg);
+            pos = expanded.find("{}", pos + arg.size());
+        }
+        tokens.push_back(expanded);
+        replaced = true;
+    }
+    if (!replaced)
+        tokens.push_back(arg);
+    return tokens;
+}
+
+// Function to start one job, returns false if the fork failed
+static bool launchJob(ParallelJob& job, const vector<string>& tokens, bool grouped, bool argsFromStdin)
+{
+    int fds[2] = {-1, -1};
+    if (grouped && pipe2(fds, O_CLOEXEC) < 0)
+    {
+        perror("parallel: pipe");
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror("parallel: fork");
+        if (grouped)
+        {
+            close(fds[0]);
+            close(fds[1]);
+        }
+        return false;
+    }
+    if (pid == 0)
+    {
+        signal(SIGINT, SIG_DFL);
+        if (grouped)
+        {
+            dup2(fds[1], STDOUT_FILENO);
+            dup2(fds[1], STDERR_FILENO);
+        }
+        if (argsFromStdin)
+        {
+            // Jobs must not eat the argument stream
+            int nullFd = open("/dev/null", O_RDONLY);
+            dup2(nullFd, STDIN_FILENO);
+            close(nullFd);
+        }
+        execTokens(tokens);
+    }
+
+    job.pid = pid;
+    job.reaped = false;
+    job.exitStatus = 0;
+    job.outFd = -1;
+    if (grouped)
+    {
+        close(fds[1]);
+        job.outFd = fds[0];
+    }
+    return true;
+}
+
+// Function to read whatever a grouped job has written, closing the pipe on EOF
+static void drainJob(ParallelJob& job)
+{
+    char buffer[16384];
+    ssize_t n = read(job.outFd, buffer, sizeof(buffer));
+    if (n > 0)
+    {
+        job.output.append(buffer, n);
+        return;
+    }
+    if (n < 0 && errno == EINTR)
+        return;
+    close(job.outFd);
+    job.outFd = -1;
+}
+
+static void writeAll(int fd, const string& data)
+{
+    size_t done = 0;
+    while (done < data.size())
+    {
+        ssize_t n = write(fd, data.data() + done, data.size() - done);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        done += n;
+    }
+}
+
+static void usage()
+{
+    cerr << "usage: parallel [-j N] [-g] [-k] command [args with {}] [::: arg...]" << endl;
+}
+
+// Function to run `parallel`: one instance of the command per argument across N job slots
+bool runParallel(const vector<string>& tokens)
+{
+    long slots = sysconf(_SC_NPROCESSORS_ONLN);
+    bool grouped = false;
+    bool keepOrder = false;
+
+    size_t i = 1;
+    for (; i < tokens.size() && tokens[i][0] == '-'; i++)
+    {
+        const string& opt = tokens[i];
+        if (opt == "-g" || opt == "--group")
+            grouped = true;
+        else if (opt == "-k" || opt == "--keep-order")
+            grouped = keepOrder = true;
+        else if (opt == "-j" && i + 1 < tokens.size())
+            slots = atol(tokens[++i].c_str());
+        else if (opt.compare(0, 2, "-j") == 0 && opt.size() > 2)
+            slots = atol(opt.c_str() + 2);
+        else
+        {
+            usage();
+            return false;
+        }
+    }
+    if (slots < 1)
+        slots = 1;
+
+    vector<string> templ;
+    for (; i < tokens.size() && tokens[i] != ":::"; i++)
+        templ.push_back(tokens[i]);
+    if (templ.empty())
+    {
+        usage();
+        return false;
+    }
+
+    // Arguments come after ::: or, without it, one per line on stdin
+    bool argsFromStdin = i == tokens.size();
+    vector<string> args;
+    if (!argsFromStdin)
+        args.assign(tokens.begin() + i + 1, tokens.end());
+
+    // Let CTRL-C stop the builtin along with its jobs
+    signal(SIGINT, SIG_DFL);
+
+    map<pid_t, ParallelJob> running;
+    map<size_t, ParallelJob> finished; // Grouped jobs waiting for their turn in -k mode
+    size_t nextIndex = 0, nextToPrint = 0;
+    bool inputDone = false;
+    int failures = 0;
+
+    while (true)
+    {
+        // Fill free slots
+        while ((long)running.size() < slots && !inputDone)
+        {
+            string arg;
+            if (argsFromStdin)
+            {
+                if (!getline(cin, arg))
+                {
+                    inputDone = true;
+                    break;
+                }
+            }
+            else
+            {
+                if (nextIndex == args.size())
+                {
+                    inputDone = true;
+                    break;
+                }
+                arg = args[nextIndex];
+            }
+
+            ParallelJob job;
+            job.index = nextIndex++;
+            if (!launchJob(job, buildJobTokens(templ, arg), grouped, argsFromStdin))
+            {
+                failures++;
+                job.reaped = true;
+                job.exitStatus = 1;
+                if (keepOrder)
+                    finished[job.index] = job;
+                continue;
+            }
+            running[job.pid] = job;
+        }
+
+        if (running.empty())
+        {
+            // Input is exhausted; print whatever -k mode is still holding back
+            for (auto& entry : finished)
+                writeAll(STDOUT_FILENO, entry.second.output);
+            break;
+        }
+
+        if (grouped && !running.empty())
+        {
+            // Collect output from every job that still has its pipe open
+            vector<struct pollfd> pfds;
+            for (auto& entry : running)
+            {
+                if (entry.second.outFd >= 0)
+                    pfds.push_back({entry.second.outFd, POLLIN, 0});
+            }
+            if (!pfds.empty() && poll(pfds.data(), pfds.size(), -1) > 0)
+            {
+                for (auto& entry : running)
+                {
+                    for (auto& p : pfds)
+                    {
+                        if (p.fd == entry.second.outFd && p.revents)
+                            drainJob(entry.second);
+                    }
+                }
+            }
+        }
+
+        // Reap finished jobs; in grouped mode a job is done once its pipe is drained too
+        for (auto it = running.begin(); it != running.end();)
+        {
+            ParallelJob& job = it->second;
+            if (grouped && job.outFd >= 0)
+            {
+                ++it;
+                continue;
+            }
+            int commstatus;
+            pid_t done = waitpid(job.pid, &commstatus, grouped ? 0 : WNOHANG);
+            if (done == 0)
+            {
+                ++it;
+                continue;
+            }
+            job.reaped = true;
+            job.exitStatus = WIFEXITED(commstatus) ? WEXITSTATUS(commstatus) : 128 + WTERMSIG(commstatus);
+            if (job.exitStatus != 0)
+                failures++;
+
+            if (keepOrder)
+                finished[job.index] = job;
+            else if (grouped)
+                writeAll(STDOUT_FILENO, job.output);
+            it = running.erase(it);
+        }
+
+        // Print grouped output in input order
+        while (keepOrder && !finished.empty() && finished.begin()->first == nextToPrint)
+        {
+            writeAll(STDOUT_FILENO, finished.begin()->second.output);
+            finished.erase(finished.begin());
+            nextToPrint++;
+        }
+
+        if (!grouped && !running.empty())
+        {
+            // Block until any job exits instead of spinning on WNOHANG
+            int commstatus;
+            pid_t done = wait(&commstatus);
+            auto it = running.find(done);
+            if (it != running.end())
+            {
+                int exitStatus = WIFEXITED(commstatus) ? WEXITSTATUS(commstatus) : 128 + WTERMSIG(commstatus);
+                if (exitStatus != 0)
+                    failures++;
+                running.erase(it);
+            }
+        }
+    }
+
+    // Like GNU parallel: the number of failed jobs, capped at 101
+    lastExitStatus = failures > 101 ? 101 : failures;
+    return true;
+}
@@ -0,0 +1,12 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Function declarations
+bool runParallel(const vector<string>& tokens);
+
+#endif // PARALLEL_H
@@ -0,0 +1,57 @@
+#!/bin/sh
+# Training workload for the profile-guided release build (make release).
+# Usage: ./pgo-train.sh ./cc
+#
+# Runs an instrumented shell through what it spends its time on: tokenizing and
+# expanding lines, builtins, pipelines, `ls -l` on a large directory and `search`
+# over a deep tree. Children leave with _exit, which skips writing profile data, so
+# builtins are mostly run through $(...): a capturable builtin runs inside the shell
+# process itself and its counters are kept.
+
+set -e
+
+SHELL_BIN=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+SCRATCH=$(mktemp -d "${TMPDIR:-/tmp}/cc-pgo.XXXXXX")
+trap 'rm -rf "$SCRATCH"' EXIT
+
+# A flat directory of 20000 files for ls, and a tree of 4000 for search
+mkdir -p "$SCRATCH/flat" "$SCRATCH/tree"
+(cd "$SCRATCH/flat" && seq -f 'file%05g.txt' 1 20000 | xargs touch)
+for d in $(seq 1 40); do
+    mkdir -p "$SCRATCH/tree/d$d/sub"
+    (cd "$SCRATCH/tree/d$d/sub" && seq -f "f$d-%03g.c" 1 100 | xargs touch)
+done
+
+# The command script; every line is parsed, expanded and run by the shell
+SCRIPT="$SCRATCH/train.cc"
+: > "$SCRIPT"
+for round in $(seq 1 20); do
+    cat >> "$SCRIPT" <<EOF
+cd $SCRATCH/flat
+echo \$(ls -l) > /dev/null
+echo \$(ls -la $SCRATCH/flat) > /dev/null
+cd $SCRATCH/tree
+echo \$(search f40-100.c) > /dev/null
+echo \$(search missing.txt) > /dev/null
+here=\$(pwd)
+N=$round
+export ROUND=\$N
+echo round \$N of \$ROUND in \$here > /dev/null
+i=0
+let i+=N*3 i*=4 i%=7
+echo \$((i * 31 + N)) \$(( N > 10 ? N : -N )) > /dev/null
+echo \$(history 5) > /dev/null
+seq 1 2000 | grep 7 | wc -l > /dev/null
+cat $SCRATCH/train.cc | head -50 | tail -5 > /dev/null
+echo a b c d e f g h i j | tr a-z A-Z > /dev/null
+cd -
+cd $SCRATCH
+echo \$(echo tree/d1/sub/*.c) > /dev/null
+ls -l tree/d2/sub > /dev/null
+unset N
+EOF
+done
+echo exit >> "$SCRIPT"
+
+cd "$SCRATCH"
+"$SHELL_BIN" < "$SCRIPT" > /dev/null 2>&1
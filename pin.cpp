@@ -0,0 +1,268 @@
+#include "pin.h"
+#include "shell.h"
+#include "vars.h"
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <map>
+#include <set>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+using namespace std;
+
+// Function to read the first line of a sysfs file, or "" if it is missing
+static string readSysfs(const string& path)
+{
+    ifstream file(path);
+    string line;
+    getline(file, line);
+    return line;
+}
+
+// Function to parse a list such as 0-3,8,10-11 into its numbers
+static bool parseList(const string& text, vector<int>& numbers)
+{
+    stringstream ss(text);
+    string range;
+    while (getline(ss, range, ','))
+    {
+        char* end;
+        long first = strtol(range.c_str(), &end, 10);
+        long last = first;
+        if (end == range.c_str() || first < 0)
+            return false;
+        if (*end == '-')
+        {
+            const char* start = end + 1;
+            last = strtol(start, &end, 10);
+            if (end == start || last < first)
+                return false;
+        }
+        if (*end != '\0' || last >= CPU_SETSIZE)
+            return false;
+        for (long n = first; n <= last; n++)
+            numbers.push_back(n);
+    }
+    return !numbers.empty();
+}
+
+// Function to print numbers back as a list, merging runs into ranges
+static string formatList(const vector<int>& numbers)
+{
+    string text;
+    for (size_t i = 0; i < numbers.size(); )
+    {
+        size_t j = i;
+        while (j + 1 < numbers.size() && numbers[j + 1] == numbers[j] + 1)
+            j++;
+        text += (text.empty() ? "" : ",") + to_string(numbers[i]);
+        if (j > i)
+            text += "-" + to_string(numbers[j]);
+        i = j + 1;
+    }
+    return text;
+}
+
+// Function to find the CPUs sharing cpu's last-level data cache, as sysfs lists them
+static string lastLevelCache(int cpu)
+{
+    string base = "/sys/devices/system/cpu/cpu" + to_string(cpu) + "/cache/index";
+    string shared;
+    int bestLevel = 0;
+    for (int index = 0; ; index++)
+    {
+        string level = readSysfs(base + to_string(index) + "/level");
+        if (level.empty())
+            break;
+        if (readSysfs(base + to_string(index) + "/type") == "Instruction")
+            continue;
+        if (atoi(level.c_str()) > bestLevel)
+        {
+            bestLevel = atoi(level.c_str());
+            shared = readSysfs(base + to_string(index) + "/shared_cpu_list");
+        }
+    }
+    return shared;
+}
+
+// Function to group the CPUs the shell may run on by the last-level cache they share.
+// Within a group, one hardware thread of each core comes before any sibling thread,
+// so a pipeline gets distinct cores before it doubles up on one. Read once per shell
+static const vector<vector<int>>& cacheDomains()
+{
+    static vector<vector<int>> domains;
+    static bool loaded = false;
+    if (loaded)
+        return domains;
+    loaded = true;
+
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return domains;
+
+    map<string, size_t> domainOf;
+    vector<vector<int>> siblings; // The same groups, second threads of a core only
+    set<string> coresSeen;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (!CPU_ISSET(cpu, &allowed))
+            continue;
+        auto found = domainOf.insert({lastLevelCache(cpu), domains.size()});
+        if (found.second)
+        {
+            domains.emplace_back();
+            siblings.emplace_back();
+        }
+        size_t domain = found.first->second;
+        string core = readSysfs("/sys/devices/system/cpu/cpu" + to_string(cpu) + "/topology/thread_siblings_list");
+        if (core.empty() || coresSeen.insert(core).second)
+            domains[domain].push_back(cpu);
+        else
+            siblings[domain].push_back(cpu);
+    }
+    for (size_t i = 0; i < domains.size(); i++)
+        domains[i].insert(domains[i].end(), siblings[i].begin(), siblings[i].end());
+    return domains;
+}
+
+// Function to choose a CPU for each stage of a pipeline when $PIN_STAGES is auto; empty otherwise.
+// The stages go to distinct cores of one shared cache, so data handed through the pipes stays
+// in that cache. Successive pipelines continue round the group instead of stacking on its first cores
+vector<int> pipelineCpus(size_t stages)
+{
+    const string* mode = lookupVariable("PIN_STAGES");
+    if (mode == nullptr || *mode != "auto" || stages < 2)
+        return vector<int>();
+    const vector<vector<int>>& domains = cacheDomains();
+    if (domains.empty())
+        return vector<int>();
+
+    // The shell's own cache if it is big enough, else the biggest
+    int current = sched_getcpu();
+    const vector<int>* chosen = &domains[0];
+    for (const auto& domain : domains)
+    {
+        if (domain.size() > chosen->size())
+            chosen = &domain;
+    }
+    for (const auto& domain : domains)
+    {
+        if (domain.size() >= stages && find(domain.begin(), domain.end(), current) != domain.end())
+            chosen = &domain;
+    }
+
+    static size_t next = 0;
+    vector<int> cpus;
+    for (size_t i = 0; i < stages; i++)
+        cpus.push_back((*chosen)[(next + i) % chosen->size()]);
+    next += stages;
+    return cpus;
+}
+
+// Function to bind the calling process to one CPU
+void pinToCpu(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set); // A CPU gone offline just leaves the stage unpinned
+}
+
+// Function to apply a NUMA memory policy for the nodes in list; glibc has no wrapper without libnuma
+static bool setMemoryPolicy(int mode, const string& list)
+{
+    vector<int> nodes;
+    if (!parseList(list, nodes))
+    {
+        cerr << "pin: bad node list " << list << endl;
+        return false;
+    }
+    const int bits = 8 * sizeof(unsigned long);
+    vector<unsigned long> mask(CPU_SETSIZE / bits);
+    for (int node : nodes)
+        mask[node / bits] |= 1UL << (node % bits);
+
+    // The kernel reads maxnode - 1 bits
+    if (syscall(SYS_set_mempolicy, mode, mask.data(), mask.size() * bits + 1) != 0)
+    {
+        perror("pin: set_mempolicy");
+        return false;
+    }
+    return true;
+}
+
+// Function to print the CPUs the shell may use, grouped by shared cache, and the memory nodes
+static void showLayout()
+{
+    const vector<vector<int>>& domains = cacheDomains();
+    vector<int> all;
+    for (const auto& domain : domains)
+        all.insert(all.end(), domain.begin(), domain.end());
+    sort(all.begin(), all.end());
+    cout << "cpus: " << formatList(all) << endl;
+    for (const auto& domain : domains)
+    {
+        vector<int> sorted = domain;
+        sort(sorted.begin(), sorted.end());
+        cout << "shared cache: " << formatList(sorted) << endl;
+    }
+    string nodes = readSysfs("/sys/devices/system/node/online");
+    cout << "memory nodes: " << (nodes.empty() ? "0" : nodes) << endl;
+}
+
+// Function to implement `pin [--mem NODES | --interleave NODES] CPUS cmd...`, or `pin` to show the layout.
+// Builtins other than the parent-only ones run in a child, so the placement never touches the shell itself
+bool runPin(vector<string>& tokens, BuiltinContext& context)
+{
+    if (tokens.size() == 1)
+    {
+        showLayout();
+        return true;
+    }
+
+    int policy = -1;
+    string nodes;
+    size_t i = 1;
+    while (i + 1 < tokens.size() && (tokens[i] == "--mem" || tokens[i] == "--interleave"))
+    {
+        policy = tokens[i] == "--mem" ? MPOL_BIND : MPOL_INTERLEAVE;
+        nodes = tokens[i + 1];
+        i += 2;
+    }
+    if (i + 1 >= tokens.size())
+    {
+        cerr << "pin: usage: pin [--mem NODES | --interleave NODES] CPUS|all command" << endl;
+        return false;
+    }
+
+    if (tokens[i] != "all")
+    {
+        vector<int> cpus;
+        if (!parseList(tokens[i], cpus))
+        {
+            cerr << "pin: bad CPU list " << tokens[i] << endl;
+            return false;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus)
+            CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        {
+            cerr << "pin: CPUs " << tokens[i] << " are not available: " << strerror(errno) << endl;
+            return false;
+        }
+    }
+    if (policy >= 0 && !setMemoryPolicy(policy, nodes))
+        return false;
+
+    // Both survive exec, and a builtin runs right here under them
+    vector<string> command(tokens.begin() + i + 1, tokens.end());
+    lastExitStatus = runWords(command, context);
+    return true;
+}
@@ -0,0 +1,15 @@
+#ifndef PIN_H
+#define PIN_H
+
+#include "builtins.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Function declarations
+bool runPin(vector<string>& tokens, BuiltinContext& context);
+vector<int> pipelineCpus(size_t stages);
+void pinToCpu(int cpu);
+
+#endif // PIN_H
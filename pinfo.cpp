@@ -1,4 +1,5 @@
 #include "pinfo.h"
+#include "ptop.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -8,6 +9,8 @@
 #include <fcntl.h>
 #include <cstring>
 #include <vector>
+#include <map>
+#include <algorithm>
 
 using namespace std;
 
@@ -81,4 +84,63 @@ void pinfo(int pid)
     cout << "Process Status -- {" << getProcStatus(pid) << "}" << endl;
     cout << "memory -- " << getProcMemory(pid) << " {Virtual Memory}" << endl;
     cout << "Executable Path -- " << getProcExecutablePath(pid) << endl;
-}
\ No newline at end of file
+}
+
+// Function to print one process and, indented below it, all of its descendants
+static void printTree(pid_t pid, const map<pid_t, ProcSample>& samples, const map<pid_t, vector<pid_t>>& children,
+                      const string& indent, long pageKb, long ticksPerSecond, long& count, long& totalRssKb)
+{
+    const ProcSample& s = samples.at(pid);
+    long rssKb = s.residentPages * pageKb;
+    unsigned long long seconds = s.cpuTicks / ticksPerSecond;
+    string exe = getProcExecutablePath(pid);
+
+    char line[128];
+    snprintf(line, sizeof(line), "%-7d %c %10ld %5llu:%02llu  ", (int)pid, s.state, rssKb, seconds / 60, seconds % 60);
+    cout << line << indent << s.comm << " -- " << (exe.empty() ? "?" : exe) << endl;
+
+    count++;
+    totalRssKb += rssKb;
+
+    auto found = children.find(pid);
+    if (found == children.end())
+        return;
+    for (pid_t child : found->second)
+    {
+        printTree(child, samples, children, indent + "  ", pageKb, ticksPerSecond, count, totalRssKb);
+    }
+}
+
+// Function to show a process and its whole descendant tree. /proc is scanned
+// once and a ppid -> children index is built, instead of one lookup per process
+void pinfoTree(int pid)
+{
+    vector<pid_t> pids;
+    listProcessIds(pids);
+
+    map<pid_t, ProcSample> samples;
+    map<pid_t, vector<pid_t>> children;
+    for (pid_t candidate : pids)
+    {
+        ProcSample sample;
+        if (!readProcSample(candidate, sample))
+            continue;
+        samples[candidate] = sample;
+        children[sample.ppid].push_back(candidate);
+    }
+
+    if (samples.find(pid) == samples.end())
+    {
+        cerr << "pinfo: no such process " << pid << endl;
+        return;
+    }
+    for (auto& entry : children)
+    {
+        sort(entry.second.begin(), entry.second.end());
+    }
+
+    long count = 0, totalRssKb = 0;
+    cout << "PID     S    RSS(kB)      TIME  COMMAND -- Executable Path" << endl;
+    printTree(pid, samples, children, "", sysconf(_SC_PAGESIZE) / 1024, sysconf(_SC_CLK_TCK), count, totalRssKb);
+    cout << count << " processes, " << totalRssKb << " kB resident" << endl;
+}
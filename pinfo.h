@@ -9,5 +9,6 @@ string getProcStatus(int pid);
 string getProcMemory(int pid);
 string getProcExecutablePath(int pid);
 void pinfo(int pid);
+void pinfoTree(int pid);
 
 #endif // PINFO_H
@@ -0,0 +1,146 @@
+#include "plugin.h"
+#include "plugin_api.h"
+#include "shell.h"
+#include "vars.h"
+#include <iostream>
+#include <map>
+#include <cstdio>
+#include <unistd.h>
+#include <dlfcn.h>
+
+using namespace std;
+
+struct LoadedPlugin
+{
+    string path;
+    void* handle;
+    cc_builtin_fn run;
+    Builtin entry;
+};
+
+// Keyed by builtin name; map nodes never move, so entry.name can point at the key
+static map<string, LoadedPlugin> plugins;
+
+// Function to call a plugin in-process: the shell already forked for it, as for any builtin
+static bool runPluginBuiltin(vector<string>& tokens, BuiltinContext& context)
+{
+    auto it = plugins.find(tokens[0]);
+    if (it == plugins.end())
+        return false;
+
+    vector<char*> argv;
+    for (auto& token : tokens)
+        argv.push_back(&token[0]);
+    argv.push_back(nullptr);
+
+    // Whatever the shell buffered must reach the fd before the plugin writes to it
+    cout.flush();
+    fflush(stdout);
+    cc_plugin_io io = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO, exportedEnvironment()};
+    lastExitStatus = it->second.run((int)tokens.size(), argv.data(), &io);
+    fflush(stdout);
+    fflush(stderr);
+    return true;
+}
+
+const Builtin* findPlugin(const string& name)
+{
+    if (plugins.empty())
+        return nullptr;
+    auto it = plugins.find(name);
+    return it == plugins.end() ? nullptr : &it->second.entry;
+}
+
+static bool loadPlugin(const string& path, const string& name)
+{
+    size_t count;
+    const Builtin* builtins = listBuiltins(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (name == builtins[i].name)
+        {
+            cerr << "enable: " << name << " is a shell builtin" << endl;
+            return false;
+        }
+    }
+    if (plugins.count(name))
+    {
+        cerr << "enable: " << name << " is already loaded from " << plugins[name].path << endl;
+        return false;
+    }
+
+    // RTLD_LOCAL keeps one plugin's symbols from resolving another's
+    void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr)
+    {
+        cerr << "enable: " << dlerror() << endl;
+        return false;
+    }
+
+    const int* abi = (const int*)dlsym(handle, "cc_plugin_abi");
+    if (abi == nullptr || *abi != CC_PLUGIN_ABI)
+    {
+        cerr << "enable: " << path << ": " << (abi == nullptr ? "missing cc_plugin_abi" : "unsupported plugin ABI version") << endl;
+        dlclose(handle);
+        return false;
+    }
+
+    string symbol = "cc_builtin_" + name;
+    cc_builtin_fn run = (cc_builtin_fn)dlsym(handle, symbol.c_str());
+    if (run == nullptr)
+    {
+        cerr << "enable: " << path << ": no " << symbol << " function" << endl;
+        dlclose(handle);
+        return false;
+    }
+
+    LoadedPlugin& plugin = plugins[name];
+    plugin.path = path;
+    plugin.handle = handle;
+    plugin.run = run;
+    plugin.entry.name = plugins.find(name)->first.c_str();
+    plugin.entry.handler = runPluginBuiltin;
+    plugin.entry.flags = BUILTIN_PIPELINE;
+    return true;
+}
+
+// Function to implement `enable [-f plugin.so name... | -d name...]`; no arguments lists plugins
+bool runEnable(const vector<string>& tokens)
+{
+    if (tokens.size() == 1)
+    {
+        for (const auto& plugin : plugins)
+            cout << "enable -f " << plugin.second.path << " " << plugin.first << endl;
+        return true;
+    }
+
+    if (tokens[1] == "-f" && tokens.size() >= 4)
+    {
+        bool ok = true;
+        for (size_t i = 3; i < tokens.size(); i++)
+            ok = loadPlugin(tokens[2], tokens[i]) && ok;
+        return ok;
+    }
+
+    if (tokens[1] == "-d" && tokens.size() >= 3)
+    {
+        bool ok = true;
+        for (size_t i = 2; i < tokens.size(); i++)
+        {
+            auto it = plugins.find(tokens[i]);
+            if (it == plugins.end())
+            {
+                cerr << "enable: " << tokens[i] << ": not a loaded plugin" << endl;
+                ok = false;
+                continue;
+            }
+            // dlopen counts references, so other names from the same file stay loaded
+            dlclose(it->second.handle);
+            plugins.erase(it);
+        }
+        return ok;
+    }
+
+    cerr << "enable: usage: enable [-f plugin.so name... | -d name...]" << endl;
+    return false;
+}
@@ -0,0 +1,14 @@
+#ifndef PLUGIN_H
+#define PLUGIN_H
+
+#include "builtins.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Function declarations
+const Builtin* findPlugin(const string& name);
+bool runEnable(const vector<string>& tokens);
+
+#endif // PLUGIN_H
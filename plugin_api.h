@@ -0,0 +1,36 @@
+#ifndef PLUGIN_API_H
+#define PLUGIN_API_H
+
+/*
+ * C ABI for builtins loaded with `enable -f plugin.so name`.
+ *
+ * A plugin exports
+ *     int cc_plugin_abi = CC_PLUGIN_ABI;
+ * and one function per builtin it provides, named cc_builtin_<name>:
+ *     int cc_builtin_<name>(int argc, char** argv, const struct cc_plugin_io* io);
+ * The return value is the command's exit status. Plugins should read and
+ * write through the descriptors in io; output left in stdio buffers is
+ * flushed by the shell when the builtin returns.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CC_PLUGIN_ABI 1
+
+struct cc_plugin_io
+{
+    int in;      /* Standard input, after pipes and redirections */
+    int out;     /* Standard output */
+    int err;     /* Standard error */
+    char** envp; /* Exported variables, NULL-terminated */
+};
+
+typedef int (*cc_builtin_fn)(int argc, char** argv, const struct cc_plugin_io* io);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLUGIN_API_H */
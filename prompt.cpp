@@ -0,0 +1,270 @@
+#include "prompt.h"
+#include "vars.h"
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <pthread.h>
+#include <limits.h>
+#include <pwd.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+
+using namespace std;
+
+// Format used when $PROMPT is not set; matches the shell's classic prompt
+static const char defaultFormat[] = "\\u@\\h:\\w> ";
+
+// Segments that never change while the shell runs, computed once at startup
+static string userName;
+static string systemName;
+static string homeDir;
+
+// The cwd segment, refreshed only when a builtin changes directory
+static string currentDir;
+
+// Cheap dynamic segments, updated after each command
+static int lastStatus = 0;
+static uint64_t lastDurationUs = 0;
+
+// Segments too slow to compute inline run on a worker thread. The prompt waits
+// for them until a deadline and otherwise shows the last value it has
+struct SegmentState
+{
+    mutex lock;
+    condition_variable ready;
+    bool workerStarted = false;
+    unsigned long requested = 0;
+    unsigned long finished = 0;
+    string dir;
+    string branch;
+};
+
+// Never destroyed: the detached worker may still be waiting on it at exit
+static SegmentState& segments = *new SegmentState;
+
+// Function to get the username
+static string getUserName() 
+{
+    struct passwd *pw;
+
+    if ((pw = getpwuid(geteuid())) != nullptr) 
+    {
+        return string(pw->pw_name);
+    } 
+    else 
+    {
+        perror("getpwuid() error");
+        return "";
+    }
+}
+
+// Function to get the system name
+static string getSystemName() 
+{
+    struct utsname buffer;
+
+    if (uname(&buffer) != 0) {
+        perror("uname");
+        return "";
+    }
+
+    return string(buffer.sysname);
+}
+
+// Function to find the checked out branch by reading .git/HEAD, walking up from dir
+static string gitBranch(string dir)
+{
+    while (!dir.empty())
+    {
+        string gitPath = dir + "/.git";
+        struct stat info;
+        if (stat(gitPath.c_str(), &info) == 0)
+        {
+            if (S_ISREG(info.st_mode))
+            {
+                // Worktrees and submodules: .git is a file naming the real directory
+                ifstream link(gitPath);
+                string line;
+                getline(link, line);
+                if (line.compare(0, 8, "gitdir: ") != 0)
+                    return "";
+                gitPath = line.substr(8);
+                if (gitPath[0] != '/')
+                    gitPath = dir + "/" + gitPath;
+            }
+            ifstream head(gitPath + "/HEAD");
+            string line;
+            if (!getline(head, line))
+                return "";
+            if (line.compare(0, 16, "ref: refs/heads/") == 0)
+                return line.substr(16);
+            return line.substr(0, 7); // Detached HEAD
+        }
+        size_t slash = dir.rfind('/');
+        if (slash == string::npos)
+            break;
+        dir.erase(slash == 0 ? 1 : slash);
+        if (dir == "/")
+        {
+            if (stat("/.git", &info) != 0)
+                break;
+        }
+    }
+    return "";
+}
+
+static void segmentWorker()
+{
+    unique_lock<mutex> lock(segments.lock);
+    while (true)
+    {
+        segments.ready.wait(lock, [] { return segments.finished != segments.requested; });
+        unsigned long generation = segments.requested;
+        string dir = segments.dir;
+
+        lock.unlock();
+        string branch = gitBranch(dir);
+        lock.lock();
+
+        segments.branch = branch;
+        segments.finished = generation;
+        segments.ready.notify_all();
+    }
+}
+
+static const string& promptFormat()
+{
+    static const string fallback = defaultFormat;
+    const string* format = lookupVariable("PROMPT");
+    return format ? *format : fallback;
+}
+
+// Function to queue a background refresh of the slow segments, if the format uses any
+static void requestSlowSegments()
+{
+    if (promptFormat().find("\\g") == string::npos)
+        return;
+
+    lock_guard<mutex> lock(segments.lock);
+    if (!segments.workerStarted)
+    {
+        // Forked children (substitutions run cd too) must not inherit a held lock
+        pthread_atfork([] { segments.lock.lock(); }, [] { segments.lock.unlock(); }, [] { segments.lock.unlock(); });
+        thread(segmentWorker).detach();
+        segments.workerStarted = true;
+    }
+    segments.dir = currentDir;
+    segments.requested++;
+    segments.ready.notify_all();
+}
+
+void initPrompt(const string& baseDir)
+{
+    userName = getUserName();
+    systemName = getSystemName();
+    homeDir = baseDir;
+    promptDirectoryChanged();
+}
+
+void promptDirectoryChanged()
+{
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd)) != NULL) 
+    {
+        currentDir = cwd;
+    } 
+    else 
+    {
+        perror("getcwd() error");
+    }
+    requestSlowSegments();
+}
+
+const string& promptCurrentDirectory()
+{
+    return currentDir;
+}
+
+void promptCommandFinished(int exitStatus, uint64_t durationUs)
+{
+    lastStatus = exitStatus;
+    lastDurationUs = durationUs;
+    requestSlowSegments(); // The command may have switched branches
+}
+
+static string formatDuration(uint64_t us)
+{
+    char buffer[32];
+    if (us < 1000000)
+        snprintf(buffer, sizeof(buffer), "%llums", (unsigned long long)(us / 1000));
+    else if (us < 60000000)
+        snprintf(buffer, sizeof(buffer), "%.1fs", us / 1e6);
+    else
+        snprintf(buffer, sizeof(buffer), "%llum%llus", (unsigned long long)(us / 60000000), (unsigned long long)(us / 1000000 % 60));
+    return buffer;
+}
+
+// Function to wait, at most PROMPT_DEADLINE_MS (default 20), for the background segments
+static string slowBranchSegment()
+{
+    long deadlineMs = 20;
+    const string* setting = lookupVariable("PROMPT_DEADLINE_MS");
+    if (setting != nullptr)
+        deadlineMs = atol(setting->c_str());
+
+    unique_lock<mutex> lock(segments.lock);
+    segments.ready.wait_for(lock, chrono::milliseconds(deadlineMs), [] { return segments.finished == segments.requested; });
+    return segments.branch; // Possibly the previous value if the deadline passed
+}
+
+// Function to build the prompt from $PROMPT: \u user, \h system, \w directory
+// (~ for the start directory), \W its last component, \g git branch, \s last
+// exit status, \d last command duration, \n newline, \\ backslash
+string renderPrompt()
+{
+    const string& format = promptFormat();
+    string prompt;
+    for (size_t i = 0; i < format.size(); i++)
+    {
+        if (format[i] != '\\' || i + 1 == format.size())
+        {
+            prompt += format[i];
+            continue;
+        }
+        char code = format[++i];
+        switch (code)
+        {
+            case 'u': prompt += userName; break;
+            case 'h': prompt += systemName; break;
+            case 'w':
+                if (currentDir.find(homeDir) == 0)
+                    prompt += "~" + currentDir.substr(homeDir.length());
+                else
+                    prompt += currentDir;
+                break;
+            case 'W':
+            {
+                size_t slash = currentDir.rfind('/');
+                prompt += slash == string::npos || currentDir.size() == 1 ? currentDir : currentDir.substr(slash + 1);
+                break;
+            }
+            case 'g': prompt += slowBranchSegment(); break;
+            case 's': prompt += to_string(lastStatus); break;
+            case 'd': prompt += formatDuration(lastDurationUs); break;
+            case 'n': prompt += '\n'; break;
+            case 'e': prompt += '\x1b'; break;
+            case '\\': prompt += '\\'; break;
+            default:
+                prompt += '\\';
+                prompt += code;
+                break;
+        }
+    }
+    return prompt;
+}
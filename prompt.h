@@ -0,0 +1,16 @@
+#ifndef PROMPT_H
+#define PROMPT_H
+
+#include <string>
+#include <cstdint>
+
+using namespace std;
+
+// Function declarations
+void initPrompt(const string& baseDir);
+void promptDirectoryChanged();
+const string& promptCurrentDirectory();
+void promptCommandFinished(int exitStatus, uint64_t durationUs);
+string renderPrompt();
+
+#endif // PROMPT_H
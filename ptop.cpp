@@ -0,0 +1,347 @@
+#include "ptop.h"
+#include <iostream>
+#include <algorithm>
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <signal.h>
+#include <sys/resource.h>
+
+using namespace std;
+
+// Open /proc files of processes already seen, so every later sample is a single
+// pread at offset 0 instead of open+read+close. Capped to stay clear of RLIMIT_NOFILE.
+// Only ptop keeps them, and only while it runs: one-shot readers such as pinfo -t
+// would otherwise leave a descriptor pair per process open in the shell
+struct ProcFds
+{
+    int statFd;
+    int statmFd;
+};
+
+static map<pid_t, ProcFds> openFds;
+static size_t maxCachedPids = 0;
+static bool keepFds = false;
+
+static int openProcFile(pid_t pid, const char* name)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/%s", (int)pid, name);
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+static void forgetPid(pid_t pid)
+{
+    auto it = openFds.find(pid);
+    if (it == openFds.end())
+        return;
+    close(it->second.statFd);
+    close(it->second.statmFd);
+    openFds.erase(it);
+}
+
+static void forgetAllPids()
+{
+    for (auto& entry : openFds)
+    {
+        close(entry.second.statFd);
+        close(entry.second.statmFd);
+    }
+    openFds.clear();
+}
+
+// Function to read a small /proc file into buf with one pread; returns its length or -1
+static ssize_t preadAll(int fd, char* buf, size_t size)
+{
+    ssize_t n;
+    do
+    {
+        n = pread(fd, buf, size - 1, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0)
+        return -1;
+    buf[n] = '\0';
+    return n;
+}
+
+static unsigned long long nextNumber(const char*& p)
+{
+    while (*p == ' ')
+        p++;
+    bool negative = *p == '-';
+    if (negative)
+        p++;
+    unsigned long long value = 0;
+    while (*p >= '0' && *p <= '9')
+        value = value * 10 + (*p++ - '0');
+    return negative ? 0 : value;
+}
+
+static void skipFields(const char*& p, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        while (*p == ' ')
+            p++;
+        while (*p && *p != ' ')
+            p++;
+    }
+}
+
+// Function to sample one process without allocating: the stat and statm files
+// are read into stack buffers and parsed in place
+bool readProcSample(pid_t pid, ProcSample& sample)
+{
+    if (maxCachedPids == 0)
+    {
+        struct rlimit limit;
+        getrlimit(RLIMIT_NOFILE, &limit);
+        maxCachedPids = limit.rlim_cur > 256 ? (limit.rlim_cur - 128) / 2 : 64;
+    }
+
+    int statFd, statmFd;
+    bool cached = false;
+    auto it = openFds.find(pid);
+    if (it != openFds.end())
+    {
+        statFd = it->second.statFd;
+        statmFd = it->second.statmFd;
+        cached = true;
+    }
+    else
+    {
+        statFd = openProcFile(pid, "stat");
+        statmFd = openProcFile(pid, "statm");
+        if (statFd < 0 || statmFd < 0)
+        {
+            if (statFd >= 0)
+                close(statFd);
+            if (statmFd >= 0)
+                close(statmFd);
+            return false;
+        }
+    }
+
+    char statBuf[1024];
+    char statmBuf[256];
+    bool ok = preadAll(statFd, statBuf, sizeof(statBuf)) > 0 && preadAll(statmFd, statmBuf, sizeof(statmBuf)) > 0;
+
+    if (!ok)
+    {
+        // The process is gone; its descriptors now only return ESRCH
+        if (cached)
+            forgetPid(pid);
+        else
+        {
+            close(statFd);
+            close(statmFd);
+        }
+        return false;
+    }
+    if (!cached)
+    {
+        if (keepFds && openFds.size() < maxCachedPids)
+            openFds[pid] = ProcFds{statFd, statmFd};
+        else
+        {
+            close(statFd);
+            close(statmFd);
+        }
+    }
+
+    // comm may contain spaces and parentheses, so it ends at the last ')'
+    const char* openParen = strchr(statBuf, '(');
+    const char* closeParen = strrchr(statBuf, ')');
+    if (openParen == nullptr || closeParen == nullptr || closeParen < openParen)
+        return false;
+    size_t commLength = min<size_t>(closeParen - openParen - 1, sizeof(sample.comm) - 1);
+    memcpy(sample.comm, openParen + 1, commLength);
+    sample.comm[commLength] = '\0';
+
+    const char* p = closeParen + 2;
+    sample.pid = pid;
+    sample.state = *p++;
+    sample.ppid = nextNumber(p);
+    skipFields(p, 1); // pgrp
+    sample.session = nextNumber(p);
+    skipFields(p, 7); // tty_nr .. cmajflt
+    unsigned long long utime = nextNumber(p);
+    unsigned long long stime = nextNumber(p);
+    sample.cpuTicks = utime + stime;
+    skipFields(p, 6); // cutime .. itrealvalue
+    sample.startTime = nextNumber(p);
+
+    const char* q = statmBuf;
+    sample.sizePages = nextNumber(q);
+    sample.residentPages = nextNumber(q);
+    return true;
+}
+
+// Function to list every numeric entry of /proc
+void listProcessIds(vector<pid_t>& pids)
+{
+    pids.clear();
+    DIR* dir = opendir("/proc");
+    if (dir == nullptr)
+    {
+        perror("opendir /proc");
+        return;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr)
+    {
+        if (entry->d_name[0] >= '1' && entry->d_name[0] <= '9')
+            pids.push_back(atoi(entry->d_name));
+    }
+    closedir(dir);
+}
+
+struct PtopRow
+{
+    ProcSample sample;
+    double cpuPercent;
+};
+
+static double monotonicSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage()
+{
+    cerr << "usage: ptop [-d seconds] [-n iterations] [-s cpu|rss] [-N rows] [-j]" << endl;
+}
+
+// Function to run `ptop`: sample processes every interval and show the busiest
+bool runPtop(const vector<string>& tokens)
+{
+    double interval = 1.0;
+    long iterations = isatty(STDOUT_FILENO) ? -1 : 1;
+    string sortKey = "cpu";
+    size_t rows = 20;
+    bool jobsOnly = false;
+
+    for (size_t i = 1; i < tokens.size(); i++)
+    {
+        const string& opt = tokens[i];
+        bool hasValue = i + 1 < tokens.size();
+        if (opt == "-d" && hasValue)
+            interval = atof(tokens[++i].c_str());
+        else if (opt == "-n" && hasValue)
+            iterations = atol(tokens[++i].c_str());
+        else if (opt == "-s" && hasValue)
+            sortKey = tokens[++i];
+        else if (opt == "-N" && hasValue)
+            rows = atol(tokens[++i].c_str());
+        else if (opt == "-j")
+            jobsOnly = true;
+        else
+        {
+            usage();
+            return false;
+        }
+    }
+    if (interval <= 0 || (sortKey != "cpu" && sortKey != "rss"))
+    {
+        usage();
+        return false;
+    }
+
+    // Let CTRL-C stop the monitor
+    signal(SIGINT, SIG_DFL);
+
+    long ticksPerSecond = sysconf(_SC_CLK_TCK);
+    long pageKb = sysconf(_SC_PAGESIZE) / 1024;
+    pid_t session = getsid(0);
+    bool clearScreen = isatty(STDOUT_FILENO);
+
+    map<pid_t, ProcSample> previous;
+    double previousTime = monotonicSeconds();
+    vector<pid_t> pids;
+    vector<PtopRow> table;
+    keepFds = true;
+
+    // The first pass only primes the deltas
+    for (long pass = 0; iterations < 0 || pass <= iterations; pass++)
+    {
+        double now = monotonicSeconds();
+        double elapsed = now - previousTime;
+        previousTime = now;
+
+        listProcessIds(pids);
+        map<pid_t, ProcSample> current;
+        table.clear();
+        for (pid_t pid : pids)
+        {
+            ProcSample sample;
+            if (!readProcSample(pid, sample))
+                continue;
+            if (jobsOnly && sample.session != session)
+                continue;
+            current[pid] = sample;
+
+            PtopRow row;
+            row.sample = sample;
+            row.cpuPercent = 0;
+            auto before = previous.find(pid);
+            if (before != previous.end() && before->second.startTime == sample.startTime && elapsed > 0)
+                row.cpuPercent = 100.0 * (sample.cpuTicks - before->second.cpuTicks) / (elapsed * ticksPerSecond);
+            table.push_back(row);
+        }
+
+        // Drop cached descriptors of processes that exited
+        for (auto& entry : previous)
+        {
+            if (current.find(entry.first) == current.end())
+                forgetPid(entry.first);
+        }
+        previous.swap(current);
+
+        if (pass > 0)
+        {
+            size_t shown = min(rows, table.size());
+            auto byKey = [&](const PtopRow& a, const PtopRow& b)
+            {
+                if (sortKey == "rss")
+                    return a.sample.residentPages > b.sample.residentPages;
+                return a.cpuPercent > b.cpuPercent ||
+                       (a.cpuPercent == b.cpuPercent && a.sample.residentPages > b.sample.residentPages);
+            };
+            partial_sort(table.begin(), table.begin() + shown, table.end(), byKey);
+
+            // Build the frame in one buffer and emit it with a single write
+            string frame;
+            char line[256];
+            if (clearScreen)
+                frame += "\x1b[H\x1b[2J";
+            snprintf(line, sizeof(line), "%zu processes%s, sorted by %s, every %.1fs\n", table.size(),
+                     jobsOnly ? " in this session" : "", sortKey.c_str(), interval);
+            frame += line;
+            snprintf(line, sizeof(line), "%7s %7s %1s %6s %10s %9s  %s\n", "PID", "PPID", "S", "%CPU", "RSS(kB)", "TIME", "COMMAND");
+            frame += line;
+            for (size_t i = 0; i < shown; i++)
+            {
+                const ProcSample& s = table[i].sample;
+                unsigned long long seconds = s.cpuTicks / ticksPerSecond;
+                snprintf(line, sizeof(line), "%7d %7d %c %6.1f %10ld %5llu:%02llu  %s\n", (int)s.pid, (int)s.ppid,
+                         s.state, table[i].cpuPercent, s.residentPages * pageKb, seconds / 60, seconds % 60, s.comm);
+                frame += line;
+            }
+            cout << frame << flush;
+        }
+
+        if (iterations < 0 || pass < iterations)
+            usleep((useconds_t)(interval * 1e6));
+    }
+    keepFds = false;
+    forgetAllPids();
+    return true;
+}
@@ -0,0 +1,29 @@
+#ifndef PTOP_H
+#define PTOP_H
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+using namespace std;
+
+// One reading of /proc/<pid>/stat and /proc/<pid>/statm
+struct ProcSample
+{
+    pid_t pid;
+    pid_t ppid;
+    pid_t session;
+    char state;
+    char comm[64];
+    unsigned long long cpuTicks;  // utime + stime
+    unsigned long long startTime; // Ticks after boot, tells a reused pid apart
+    long residentPages;
+    long sizePages;
+};
+
+// Function declarations
+bool readProcSample(pid_t pid, ProcSample& sample);
+void listProcessIds(vector<pid_t>& pids);
+bool runPtop(const vector<string>& tokens);
+
+#endif // PTOP_H
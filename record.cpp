@@ -0,0 +1,165 @@
+#include "record.h"
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+using namespace std;
+
+// Log layout: the magic below, then one record per input line. Every number is
+// an LEB128 varint and the start time is stored as a delta from the previous
+// record, so a typical line costs a handful of bytes plus its text. The cwd is
+// only written when it differs from the previous record's.
+static const char sessionMagic[] = "CCSESS1";
+
+static FILE* sessionLog = nullptr;
+static uint64_t lastStartUs = 0;
+static string lastCwd;
+
+uint64_t wallClockUs()
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void putVarint(string& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out += (char)((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += (char)value;
+}
+
+static bool getVarint(const string& in, size_t& pos, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < in.size(); shift += 7)
+    {
+        unsigned char byte = in[pos++];
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+static bool getBytes(const string& in, size_t& pos, string& out)
+{
+    uint64_t length;
+    if (!getVarint(in, pos, length) || length > in.size() - pos)
+        return false;
+    out.assign(in, pos, length);
+    pos += length;
+    return true;
+}
+
+bool openSessionLog(const string& path)
+{
+    sessionLog = fopen(path.c_str(), "wb");
+    if (sessionLog == nullptr)
+    {
+        perror("record: cannot open log");
+        return false;
+    }
+    fwrite(sessionMagic, 1, sizeof(sessionMagic), sessionLog);
+    fflush(sessionLog); // Forked children must not inherit unflushed bytes
+    lastStartUs = 0;
+    lastCwd.clear();
+    return true;
+}
+
+void recordCommand(const SessionRecord& record)
+{
+    if (sessionLog == nullptr)
+        return;
+
+    string out;
+    putVarint(out, record.startUs - lastStartUs);
+    putVarint(out, record.durationUs);
+    putVarint(out, (uint64_t)record.exitStatus);
+    if (record.cwd == lastCwd)
+    {
+        putVarint(out, 0);
+    }
+    else
+    {
+        putVarint(out, 1);
+        putVarint(out, record.cwd.size());
+        out += record.cwd;
+    }
+    putVarint(out, record.line.size());
+    out += record.line;
+
+    fwrite(out.data(), 1, out.size(), sessionLog);
+    fflush(sessionLog); // Keep the log usable if the shell is killed
+
+    lastStartUs = record.startUs;
+    lastCwd = record.cwd;
+}
+
+void closeSessionLog()
+{
+    if (sessionLog != nullptr)
+    {
+        fclose(sessionLog);
+        sessionLog = nullptr;
+    }
+}
+
+bool readSessionLog(const string& path, vector<SessionRecord>& records)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        perror("replay: cannot open log");
+        return false;
+    }
+    struct stat info;
+    fstat(fd, &info);
+    string data(info.st_size, '\0');
+    ssize_t got = read(fd, &data[0], data.size());
+    close(fd);
+
+    if (got != (ssize_t)data.size() || data.compare(0, sizeof(sessionMagic), string(sessionMagic, sizeof(sessionMagic))) != 0)
+    {
+        cerr << "replay: " << path << " is not a session log" << endl;
+        return false;
+    }
+
+    size_t pos = sizeof(sessionMagic);
+    uint64_t startUs = 0;
+    string cwd;
+    while (pos < data.size())
+    {
+        SessionRecord record;
+        uint64_t delta, status, cwdChanged;
+        if (!getVarint(data, pos, delta) || !getVarint(data, pos, record.durationUs) ||
+            !getVarint(data, pos, status) || !getVarint(data, pos, cwdChanged))
+        {
+            cerr << "replay: truncated record " << records.size() << endl;
+            break;
+        }
+        if (cwdChanged && !getBytes(data, pos, cwd))
+        {
+            cerr << "replay: truncated record " << records.size() << endl;
+            break;
+        }
+        if (!getBytes(data, pos, record.line))
+        {
+            cerr << "replay: truncated record " << records.size() << endl;
+            break;
+        }
+        startUs += delta;
+        record.startUs = startUs;
+        record.exitStatus = (int)status;
+        record.cwd = cwd;
+        records.push_back(record);
+    }
+    return true;
+}
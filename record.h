@@ -0,0 +1,27 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+// One input line of a recorded session
+struct SessionRecord
+{
+    uint64_t startUs;     // Wall clock time the line was submitted (microseconds since epoch)
+    uint64_t durationUs;  // Time the shell spent running the line
+    int exitStatus;       // Status of the last command on the line
+    string cwd;           // Working directory when the line was submitted
+    string line;          // The input line itself
+};
+
+// Function declarations
+bool openSessionLog(const string& path);
+void recordCommand(const SessionRecord& record);
+void closeSessionLog();
+bool readSessionLog(const string& path, vector<SessionRecord>& records);
+uint64_t wallClockUs();
+
+#endif // RECORD_H
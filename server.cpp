@@ -0,0 +1,503 @@
+#include "server.h"
+#include "shell.h"
+#include "history.h"
+#include "vars.h"
+#include <iostream>
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+// The server is one warm shell process. Each session keeps its own cwd (as a
+// dirfd), previous directory and variables; every command line runs in a
+// child forked from the server, so it starts with the server's caches already
+// built and copies the session's state in before running. What the line
+// changes (cwd, variables, status) is reported back over a pipe.
+
+// Byte a client sends when its user presses Ctrl-C
+static const char interruptByte = 'I';
+
+struct SessionVariable
+{
+    string value;
+    bool exported;
+    bool unset;
+};
+
+struct Session
+{
+    int socket = -1;
+    int fds[3] = {-1, -1, -1}; // The client's stdin, stdout and stderr
+    int dirFd = -1;
+    string previousDir;
+    map<string, SessionVariable> variables;
+    int lastStatus = 0;
+    bool disconnected = false;
+};
+
+// Shared by all sessions
+static string* serverBaseDir;
+static vector<string>* sharedHistory;
+static mutex historyMutex;
+
+static mutex queueMutex;
+static condition_variable queueReady;
+static deque<int> pendingClients;
+
+static char socketPathBuffer[sizeof(((sockaddr_un*)nullptr)->sun_path)];
+static int clientSocket = -1;
+
+static void appendField(string& out, const string& field)
+{
+    uint32_t length = field.size();
+    out.append((const char*)&length, sizeof(length));
+    out += field;
+}
+
+static bool readField(const string& in, size_t& offset, string& field)
+{
+    uint32_t length;
+    if (offset + sizeof(length) > in.size())
+        return false;
+    memcpy(&length, in.data() + offset, sizeof(length));
+    offset += sizeof(length);
+    if (offset + length > in.size())
+        return false;
+    field.assign(in, offset, length);
+    offset += length;
+    return true;
+}
+
+// Function to receive the client's hello: its cwd, with its stdin/stdout/stderr attached
+static bool receiveHello(Session& session)
+{
+    char path[PATH_MAX];
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    iovec iov = {path, sizeof(path) - 1};
+    msghdr message = {};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    ssize_t received = recvmsg(session.socket, &message, MSG_CMSG_CLOEXEC);
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    if (received <= 0 || header == nullptr || header->cmsg_type != SCM_RIGHTS || header->cmsg_len != CMSG_LEN(3 * sizeof(int)))
+        return false;
+    memcpy(session.fds, CMSG_DATA(header), 3 * sizeof(int));
+    path[received] = '\0';
+
+    session.dirFd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (session.dirFd < 0)
+        session.dirFd = open(serverBaseDir->c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    return session.dirFd >= 0;
+}
+
+// Function to tell whether the client sent Ctrl-C or went away; returns false on disconnect
+static bool handleClientByte(Session& session, pid_t running)
+{
+    char byte;
+    ssize_t count = read(session.socket, &byte, 1);
+    if (count == 1 && byte == interruptByte)
+    {
+        if (running > 0)
+            kill(-running, SIGINT);
+        return true;
+    }
+    if (count < 0 && errno == EINTR)
+        return true;
+    session.disconnected = true;
+    if (running > 0)
+        kill(-running, SIGHUP);
+    return false;
+}
+
+// Function to read one line from the client's stdin a byte at a time, so input
+// meant for the commands themselves is never consumed by the session
+static bool readSessionLine(Session& session, string& line)
+{
+    line.clear();
+    while (true)
+    {
+        pollfd fds[2] = {{session.fds[0], POLLIN, 0}, {session.socket, POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        if (fds[1].revents != 0 && !handleClientByte(session, -1))
+            return false;
+        if (fds[0].revents == 0)
+            continue;
+
+        char c;
+        ssize_t count = read(session.fds[0], &c, 1);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return !line.empty();
+        if (c == '\n')
+            return true;
+        line += c;
+    }
+}
+
+// Function run in the forked child: enter the session's state, run the line, report back
+static void runLineInChild(Session& session, const string& line, int reportFd)
+{
+    setpgid(0, 0);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTSTP, SIG_DFL);
+    signal(SIGPIPE, SIG_DFL);
+
+    for (int fd = 0; fd < 3; fd++)
+        dup2(session.fds[fd], fd);
+    if (fchdir(session.dirFd) != 0)
+        perror("session: fchdir");
+
+    for (const auto& variable : session.variables)
+    {
+        if (variable.second.unset)
+            unsetVariable(variable.first);
+        else
+            setVariable(variable.first, variable.second.value, variable.second.exported);
+    }
+    journalVariableChanges(true);
+    previousDir = session.previousDir;
+    lastExitStatus = session.lastStatus;
+
+    char cwd[PATH_MAX];
+    string baseDir = *serverBaseDir;
+    string currentDir = getcwd(cwd, sizeof(cwd)) != nullptr ? cwd : baseDir;
+    int status = 1;
+    executeInputLine(line, baseDir, currentDir, *sharedHistory, status);
+    cout.flush();
+
+    string report;
+    appendField(report, to_string(status));
+    appendField(report, to_string(lastExitStatus));
+    appendField(report, getcwd(cwd, sizeof(cwd)) != nullptr ? cwd : "");
+    appendField(report, previousDir);
+    for (const VariableChange& change : variableJournal())
+    {
+        appendField(report, change.name);
+        appendField(report, change.value);
+        appendField(report, string(1, change.unset ? 'u' : change.exported ? 'x' : 's'));
+    }
+    if (write(reportFd, report.data(), report.size()) < 0)
+        perror("session: report");
+    _exit(0);
+}
+
+// Function to run one line for a session; returns false once the session should end
+static bool runSessionLine(Session& session, const string& line)
+{
+    int reportPipe[2];
+    if (pipe2(reportPipe, O_CLOEXEC) < 0)
+    {
+        perror("session: pipe");
+        return false;
+    }
+
+    pid_t pid;
+    {
+        // Hold the lock across fork so the child never copies a half-updated history
+        lock_guard<mutex> lock(historyMutex);
+        pid = fork();
+    }
+    if (pid < 0)
+    {
+        perror("session: fork");
+        close(reportPipe[0]);
+        close(reportPipe[1]);
+        return false;
+    }
+    if (pid == 0)
+    {
+        close(reportPipe[0]);
+        runLineInChild(session, line, reportPipe[1]);
+    }
+    setpgid(pid, pid); // Also done by the child; whichever runs first wins the race with kill
+    close(reportPipe[1]);
+
+    string report;
+    char buffer[4096];
+    while (true)
+    {
+        pollfd fds[2] = {{reportPipe[0], POLLIN, 0}, {session.socket, session.disconnected ? (short)0 : (short)POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[1].revents != 0)
+            handleClientByte(session, pid);
+        if (fds[0].revents == 0)
+            continue;
+        ssize_t count = read(reportPipe[0], buffer, sizeof(buffer));
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            break;
+        report.append(buffer, count);
+    }
+    close(reportPipe[0]);
+
+    int childStatus;
+    while (waitpid(pid, &childStatus, 0) < 0 && errno == EINTR)
+        ;
+
+    // A child killed mid-line (Ctrl-C) sends no report and changes nothing
+    size_t offset = 0;
+    string status, exitStatus, cwd, oldDir;
+    if (!readField(report, offset, status) || !readField(report, offset, exitStatus) || !readField(report, offset, cwd) || !readField(report, offset, oldDir))
+    {
+        session.lastStatus = WIFSIGNALED(childStatus) ? 128 + WTERMSIG(childStatus) : 1;
+        return !session.disconnected;
+    }
+    session.lastStatus = atoi(exitStatus.c_str());
+    session.previousDir = oldDir;
+
+    string name, value, kind;
+    while (readField(report, offset, name) && readField(report, offset, value) && readField(report, offset, kind))
+    {
+        SessionVariable& variable = session.variables[name];
+        variable.value = value;
+        variable.exported = kind == "x";
+        variable.unset = kind == "u";
+    }
+
+    int dirFd = cwd.empty() ? -1 : open(cwd.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd >= 0)
+    {
+        close(session.dirFd);
+        session.dirFd = dirFd;
+    }
+    return status != "0" && !session.disconnected;
+}
+
+static void runSession(int socket)
+{
+    Session session;
+    session.socket = socket;
+    if (receiveHello(session))
+    {
+        bool interactive = isatty(session.fds[0]);
+        string line;
+        while (true)
+        {
+            if (interactive)
+            {
+                char cwd[PATH_MAX];
+                string prompt = "[cc] ";
+                // Read the path through the dirfd: the server's own cwd never moves
+                string link = "/proc/self/fd/" + to_string(session.dirFd);
+                ssize_t length = readlink(link.c_str(), cwd, sizeof(cwd) - 1);
+                if (length > 0)
+                    prompt += string(cwd, length);
+                prompt += "> ";
+                if (write(session.fds[1], prompt.data(), prompt.size()) < 0)
+                    break;
+            }
+            if (!readSessionLine(session, line))
+                break;
+            if (trim(line).empty())
+                continue;
+            {
+                lock_guard<mutex> lock(historyMutex);
+                addCommToHistory(line, *sharedHistory);
+            }
+            if (!runSessionLine(session, line))
+                break;
+        }
+    }
+
+    // The client exits with the status of the session's last command
+    uint32_t code = session.lastStatus;
+    if (!session.disconnected)
+        send(socket, &code, sizeof(code), MSG_NOSIGNAL);
+    for (int fd : session.fds)
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+    if (session.dirFd >= 0)
+        close(session.dirFd);
+    close(socket);
+}
+
+static void sessionWorker()
+{
+    while (true)
+    {
+        int socket;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            queueReady.wait(lock, [] { return !pendingClients.empty(); });
+            socket = pendingClients.front();
+            pendingClients.pop_front();
+        }
+        runSession(socket);
+    }
+}
+
+static void stopServer(int signum)
+{
+    unlink(socketPathBuffer);
+    _exit(128 + signum);
+}
+
+// Function to serve sessions on a Unix socket with a pool of session threads
+int runServer(const string& socketPath, int threads, string& baseDir, vector<string>& history)
+{
+    if (socketPath.size() >= sizeof(socketPathBuffer))
+    {
+        cerr << "server: socket path too long" << endl;
+        return 1;
+    }
+    strcpy(socketPathBuffer, socketPath.c_str());
+
+    int listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0)
+    {
+        perror("server: socket");
+        return 1;
+    }
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPathBuffer);
+
+    // A socket left behind by a previous server is replaced; any other file is not
+    struct stat info;
+    if (lstat(socketPathBuffer, &info) == 0 && S_ISSOCK(info.st_mode))
+        unlink(socketPathBuffer);
+    mode_t oldMask = umask(077); // Only this user may connect
+    int bound = bind(listenFd, (sockaddr*)&address, sizeof(address));
+    umask(oldMask);
+    if (bound < 0 || listen(listenFd, 128) < 0)
+    {
+        perror("server: bind");
+        close(listenFd);
+        return 1;
+    }
+
+    // Reading a client's terminal from the terminal's own session would raise SIGTTIN
+    setsid();
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    signal(SIGHUP, stopServer);
+
+    // Warm what every command line would otherwise build again. Only the environment
+    // block is warmed: caches a line fills while running (glob listings, parsed $((...)),
+    // the z database) are built in its child and go away with it. Glob listings are
+    // per command anyway, and the z index must see the visits of every session, so the
+    // server does not build them for its children
+    serverBaseDir = &baseDir;
+    sharedHistory = &history;
+    exportedEnvironment();
+
+    for (int i = 0; i < threads; i++)
+        thread(sessionWorker).detach();
+    cerr << "server: listening on " << socketPath << " with " << threads << " session threads" << endl;
+
+    while (true)
+    {
+        int client = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0)
+        {
+            if (errno != EINTR)
+                perror("server: accept");
+            continue;
+        }
+        lock_guard<mutex> lock(queueMutex);
+        pendingClients.push_back(client);
+        queueReady.notify_one();
+    }
+}
+
+static void forwardInterrupt(int)
+{
+    if (write(clientSocket, &interruptByte, 1) < 0)
+        return;
+}
+
+// Function to attach this terminal (or these pipes) to a server session
+int runClient(const string& socketPath)
+{
+    sockaddr_un address = {};
+    if (socketPath.size() >= sizeof(address.sun_path))
+    {
+        cerr << "connect: socket path too long" << endl;
+        return 1;
+    }
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath.c_str());
+
+    clientSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (clientSocket < 0 || connect(clientSocket, (sockaddr*)&address, sizeof(address)) < 0)
+    {
+        perror("connect");
+        return 1;
+    }
+
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd)) == nullptr)
+        strcpy(cwd, "/");
+    int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    char control[CMSG_SPACE(sizeof(fds))] = {};
+    iovec iov = {cwd, strlen(cwd)};
+    msghdr message = {};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(header), fds, sizeof(fds));
+    if (sendmsg(clientSocket, &message, 0) < 0)
+    {
+        perror("connect: sendmsg");
+        return 1;
+    }
+
+    struct sigaction sa = {};
+    sa.sa_handler = forwardInterrupt;
+    sigaction(SIGINT, &sa, nullptr);
+
+    // Everything runs on the server; just wait for the final status
+    uint32_t code = 1;
+    size_t got = 0;
+    while (got < sizeof(code))
+    {
+        ssize_t count = read(clientSocket, (char*)&code + got, sizeof(code) - got);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+        {
+            cerr << "connect: server closed the session" << endl;
+            return 1;
+        }
+        got += count;
+    }
+    return code;
+}
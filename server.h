@@ -0,0 +1,13 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Function declarations
+int runServer(const string& socketPath, int threads, string& baseDir, vector<string>& history);
+int runClient(const string& socketPath);
+
+#endif // SERVER_H
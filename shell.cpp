@@ -1,12 +1,17 @@
 #include "shell.h"
-#include "cd.h"
-#include "echo.h"
-#include "pwd.h"
-#include "history.h"
-#include "search.h"
-#include "ls.h"
-#include "pinfo.h"
+#include "expand.h"
+#include "vars.h"
+#include "glob.h"
+#include "builtins.h"
+#include "cache.h"
+#include "pin.h"
+#include "limit.h"
+#include "arena.h"
+#include "zygote.h"
 #include <cstring>
+#include <cerrno>
+#include <climits>
+#include <csignal>
 #include <iostream>
 #include <unistd.h>
 #include <sys/wait.h>
@@ -18,6 +23,12 @@ using namespace std;
 
 string previousDir;
 
+// Global variable to track the foreground process ID
+pid_t foregroundPid = -1;
+
+// Exit status of the most recently completed command
+int lastExitStatus = 0;
+
 long calculateTotalBlocks(const string& path, bool includeHidden) 
 {
     DIR *dir;
@@ -62,50 +73,124 @@ string trim(const string& str)
     return str.substr(first, (last - first + 1));
 }
 
-vector<string> tokenizeByPipe(const string& input) 
+// Function to tell whether input[i] is a word on its own, like the braces of a { ... } group
+static bool isStandalone(const string& input, size_t i) 
+{
+    bool before = i == 0 || isspace((unsigned char)input[i - 1]) || input[i - 1] == ';' || input[i - 1] == '&';
+    bool after = i + 1 == input.size() || isspace((unsigned char)input[i + 1]) || input[i + 1] == ';' || input[i + 1] == '|';
+    return before && after;
+}
+
+// Function to split input on a separator that is not quoted or inside $(...), <(...), >(...), backticks or { ... }
+vector<string> splitTopLevel(const string& input, char separator) 
 {
     vector<string> tokens;
-    stringstream ss(input);
-    string token;
+    size_t start = 0; // Where the current token begins
+    int depth = 0;
+    int braces = 0;
+    char quote = 0;
+    bool inBackticks = false;
 
-    while (getline(ss, token, '|')) 
+    for (size_t i = 0; i < input.size(); i++) 
     {
-        // Trim whitespace from the token and add to the vector
-        tokens.push_back(trim(token));
+        char c = input[i];
+        if (quote != 0) 
+        {
+            if (c == quote)
+                quote = 0;
+        } 
+        else if (c == '\'' || c == '"') 
+        {
+            quote = c;
+        } 
+        else if (c == '`') 
+        {
+            inBackticks = !inBackticks;
+        } 
+        else if ((c == '$' || c == '<' || c == '>') && i + 1 < input.size() && input[i + 1] == '(') 
+        {
+            depth++;
+            i++;
+        } 
+        else if (c == ')' && depth > 0) 
+        {
+            depth--;
+        } 
+        else if (c == '{' && isStandalone(input, i)) 
+        {
+            braces++;
+        } 
+        else if (c == '}' && braces > 0 && isStandalone(input, i)) 
+        {
+            braces--;
+        } 
+        else if (c == separator && depth == 0 && braces == 0 && !inBackticks) 
+        {
+            // Trim whitespace from the token and add to the vector
+            tokens.push_back(trim(input.substr(start, i - start)));
+            start = i + 1;
+        }
     }
-    
+
+    // Like getline, a trailing separator does not produce an empty token
+    if (start < input.size())
+        tokens.push_back(trim(input.substr(start)));
+
     return tokens;
 }
 
+vector<string> tokenizeByPipe(const string& input) 
+{
+    return splitTopLevel(input, '|');
+}
+
 // Function to tokenize input based on semicolon
 vector<string> tokenizeBySemicolon(const string& input) 
 {
-    vector<string> tokens;
-    stringstream ss(input);
-    string token;
+    return splitTopLevel(input, ';');
+}
 
-    while (getline(ss, token, ';')) 
+// Function to cut the next word out of text in place, as strtok does, except that delimiters
+// inside '...' or "..." belong to the word; the quotes stay in it. Returns nullptr at the end
+static char* nextWord(char*& cursor, const char* delimiters) 
+{
+    cursor += strspn(cursor, delimiters);
+    if (*cursor == '\0') 
+        return nullptr;
+
+    // Jump from quote to quote with the string functions instead of testing every character
+    char stops[16] = "'\"";
+    strncat(stops, delimiters, sizeof(stops) - 3);
+    char* word = cursor;
+    while (*(cursor += strcspn(cursor, stops)) != '\0') 
     {
-        // Trim whitespace from the token and add to the vector
-        tokens.push_back(trim(token));
+        if (*cursor != '\'' && *cursor != '"') 
+        {
+            *cursor++ = '\0';
+            break;
+        }
+        char* close = strchr(cursor + 1, *cursor);
+        if (close == nullptr) 
+        {
+            cursor += strlen(cursor); // An unclosed quote runs to the end of the line
+            break;
+        }
+        cursor = close + 1;
     }
-
-    return tokens;
+    return word;
 }
 
 vector<string> tokenize(const string& input) 
 {
-    
     vector<string> tokens;
-    char* str = new char[input.length() + 1];
-    strcpy(str, input.c_str());
 
-    char* token = strtok(str, " \t");
+    // The words are cut from a writable copy; it is scratch space, so it lives in the line arena
+    ArenaScope scratch;
+    char* cursor = lineArena().copy(input.c_str(), input.length());
 
-    while (token != NULL) 
+    for (char* token = nextWord(cursor, " \t"); token != nullptr; token = nextWord(cursor, " \t")) 
     {
         tokens.push_back(string(token));
-        token = strtok(NULL, " \t");
     }
 
     return tokens;
@@ -126,34 +211,93 @@ string join(const vector<string>& tokens, const string& delimiter)
     return result;
 }
 
+// Function to copy words into a null-terminated argv in the line arena, removing their
+// quotes if they are still shell words; the array only has to live until exec
+static char** buildArgv(const vector<string>& words, bool unquote) 
+{
+    char** args = static_cast<char**>(lineArena().allocate((words.size() + 1) * sizeof(char*)));
+    for (size_t i = 0; i < words.size(); i++) 
+    {
+        string word = unquote ? removeQuotes(words[i]) : words[i];
+        args[i] = lineArena().copy(word.c_str(), word.size());
+    }
+    args[words.size()] = nullptr; // Null-terminate the argument list
+    return args;
+}
+
+// Function to replace the calling (child) process with args; never returns
+static void execArgv(char** args) 
+{
+    // Limits from ulimit apply to the command, not to the shell that set them
+    applyJobLimits();
+    execvpe(args[0], args, exportedEnvironment());
+    int execErrno = errno;
+    perror("Error executing command");
+
+    // _exit so the child never flushes stdio buffers or rewinds stdin it shares with the shell
+    _exit(execErrno == ENOENT ? 127 : 126); // Exit the child process with an error status
+}
+
+// Function to replace the calling (child) process with the command in tokens; never returns
+void execTokens(const vector<string>& tokens) 
+{
+    execArgv(buildArgv(tokens, true));
+}
+
+// Function to run words whose quotes are already removed, as the command of a builtin such as
+// pin, limit or cache receives them: a builtin runs right here with its exit status returned,
+// anything else replaces the calling (child) process
+int runWords(vector<string>& words, BuiltinContext& context) 
+{
+    const Builtin* builtin = findBuiltin(words[0]);
+    if (builtin == nullptr) 
+        execArgv(buildArgv(words, false));
+
+    string input = join(words, " ");
+    BuiltinContext wordsContext = {context.baseDir, context.currentDir, input, context.history, context.status};
+    lastExitStatus = 0;
+    bool ok = builtin->handler(words, wordsContext);
+    cout.flush();
+    return ok ? lastExitStatus : 1;
+}
+
 vector<string> tokenizeWithRedirection(const string& input, string& inputFile, string& outputFile, int& outputMode) 
 {
     vector<string> tokens;
-    stringstream ss(input);
-    string token;
 
     inputFile = "";
     outputFile = "";
     outputMode = O_TRUNC; // Default output mode
 
-    while (ss >> token) 
+    ArenaScope scratch;
+    char* cursor = lineArena().copy(input.c_str(), input.length());
+    const char* delimiters = " \t\n\v\f\r";
+
+    // A quoted '>' is an argument, not a redirection: operators are compared before quote removal
+    string* target = nullptr; // Set after <, > or >>: the word that follows names the file
+    for (char* token = nextWord(cursor, delimiters); token != nullptr; token = nextWord(cursor, delimiters)) 
     {
-        if (token == "<") 
+        if (target != nullptr) 
         {
-            ss >> inputFile; // Get the input file
+            *target = removeQuotes(token);
+            target = nullptr;
         } 
-        else if (token == ">") 
+        else if (strcmp(token, "<") == 0) 
         {
-            ss >> outputFile; // Get the output file
+            target = &inputFile; // Get the input file
         } 
-        else if (token == ">>") 
+        else if (strcmp(token, ">") == 0) 
         {
-            ss >> outputFile; // Get the output file
+            target = &outputFile; // Get the output file
+        } 
+        else if (strcmp(token, ">>") == 0) 
+        {
+            target = &outputFile; // Get the output file
             outputMode = O_APPEND; // Change to append mode
         } 
         else 
         {
-            tokens.push_back(trim(token)); // Add the token to the command list
+            tokens.push_back(token); // Add the token to the command list
         }
     }
     return tokens;
@@ -178,7 +322,7 @@ bool executeCommandWithRedirection(const vector<string>& tokens, const string& i
             if (inputFd < 0) 
             {
                 cerr << "Error: Cannot open input file." << endl;
-                exit(EXIT_FAILURE);
+                _exit(EXIT_FAILURE);
             }
             dup2(inputFd, STDIN_FILENO);
             close(inputFd);
@@ -191,322 +335,456 @@ bool executeCommandWithRedirection(const vector<string>& tokens, const string& i
             if (outputFd < 0) 
             {
                 cerr << "Error: Cannot open output file." << endl;
-                exit(EXIT_FAILURE);
+                _exit(EXIT_FAILURE);
             }
             dup2(outputFd, STDOUT_FILENO);
             close(outputFd);
         }
 
-        // Prepare arguments for execvp
-        vector<char*> args;
-        for (const auto& token : tokens) 
-        {
-            args.push_back(const_cast<char*>(token.c_str()));
-        }
-        args.push_back(nullptr); // Null-terminate the argument list
-
-        // Execute the command
-        if (execvp(args[0], args.data()) < 0) 
-        {
-            perror("Execvp failed");
-            exit(EXIT_FAILURE);
-        }
+        execTokens(tokens);
     }
 
     // Parent process waits for the child
-    waitpid(pid, nullptr, 0);
+    int commstatus;
+    waitpid(pid, &commstatus, 0);
+    lastExitStatus = WIFEXITED(commstatus) ? WEXITSTATUS(commstatus) : 128 + WTERMSIG(commstatus);
     return true;
 }
 
-bool executePipeline(const vector<vector<string>>& commands, string& baseDir, string& currentDir, vector<string>& history, int& status) 
+// Function to remove the quotes from a builtin's words
+static void removeBuiltinQuotes(const Builtin* builtin, vector<string>& words) 
 {
-    int numCommands = commands.size();
-    int pipefds[2 * numCommands]; // Pipes for communication between processes
+    for (auto& word : words) 
+        word = removeQuotes(word);
+}
 
-    // Create pipes for all processes
-    for (int i = 0; i < numCommands - 1; i++) 
+// Function to start an external command from the zygote instead of forking the shell. The
+// redirection files are opened here, and inputFd and outputFd are used when there are none.
+// Returns -1, with nothing started, if the command must be forked: builtins, NAME=value words,
+// files that cannot be opened (the forked path reports them) and lines with <(...) or >(...),
+// whose /dev/fd paths only the shell's own children can open
+static pid_t spawnExternal(const vector<string>& tokens, const string& inputFile, const string& outputFile, int outputMode, int inputFd, int outputFd, int cpu) 
+{
+    if (tokens.empty() || isAssignment(tokens[0]) || findBuiltin(tokens[0]) != nullptr || processSubstitutionsActive()) 
+        return -1;
+
+    int input = inputFd, output = outputFd;
+    if (!inputFile.empty() && (input = open(inputFile.c_str(), O_RDONLY | O_CLOEXEC)) < 0) 
+        return -1;
+    if (!outputFile.empty() && (output = open(outputFile.c_str(), O_WRONLY | O_CREAT | outputMode | O_CLOEXEC, 0644)) < 0) 
     {
-        if (pipe(pipefds + i * 2) < 0) 
-        {
-            perror("Pipe creation failed");
-            return false;
-        }
+        if (!inputFile.empty()) 
+            close(input);
+        return -1;
     }
 
-    int pid;
-    for (int i = 0; i < numCommands; i++) 
+    vector<string> words;
+    for (const string& token : tokens) 
+        words.push_back(removeQuotes(token));
+    pid_t pid = zygoteSpawn(words, input, output, cpu);
+    if (!inputFile.empty()) 
+        close(input);
+    if (!outputFile.empty()) 
+        close(output);
+    return pid;
+}
+
+// Function to start one pipeline stage reading inputFd and writing outputFd (-1 keeps the
+// shell's own); closeFds are every other pipe end the stage must not hold open, and cpu
+// is the one the stage is pinned to (-1 leaves the shell's affinity)
+static pid_t startStage(const vector<string>& command, int inputFd, int outputFd, const vector<int>& closeFds, int cpu, string& baseDir, string& currentDir, vector<string>& history, int& status) 
+{
+    // An external command is cloned from the zygote; the pipe ends it gets are the only ones it holds
+    if (zygoteAvailable()) 
+    {
+        string inputFile, outputFile;
+        int outputMode;
+        vector<string> commandTokens = tokenizeWithRedirection(trim(join(command, " ")), inputFile, outputFile, outputMode);
+        pid_t pid = spawnExternal(commandTokens, inputFile, outputFile, outputMode, inputFd, outputFd, cpu);
+        if (pid > 0) 
+            return pid;
+    }
+
+    pid_t pid = fork();
+    if (pid != 0) 
     {
-        pid = fork();
         if (pid < 0) 
-        {
             perror("Fork failed");
-            return false;
-        } 
-        else if (pid == 0) 
-        {
-            // Child process
-
-            // Check for I/O redirection
-            string inputFile, outputFile;
-            int outputMode;
-            vector<string> commandTokens = commands[i]; // Get the command for this process
-
-            // Tokenize the command to check for redirection
-            commandTokens = tokenizeWithRedirection(trim(join(commandTokens, " ")), inputFile, outputFile, outputMode);
+        return pid;
+    }
 
-            // If not the first command, set input to previous pipe's read end
-            if (i > 0) 
-            {
-                if (dup2(pipefds[(i - 1) * 2], 0) < 0) 
-                {
-                    perror("Dup2 input failed");
-                    exit(1);
-                }
-            }
+    // Child process
+    if (cpu >= 0) 
+        pinToCpu(cpu);
 
-            // If not the last command, set output to next pipe's write end
-            if (i < numCommands - 1) 
-            {
-                if (dup2(pipefds[i * 2 + 1], 1) < 0) 
-                {
-                    perror("Dup2 output failed");
-                    exit(1);
-                }
-            }
-
-            // Handle input redirection
-            if (!inputFile.empty()) 
-            {
-                int inputFd = open(inputFile.c_str(), O_RDONLY);
-                if (inputFd < 0) 
-                {
-                    cerr << "Error: Cannot open input file." << endl;
-                    exit(EXIT_FAILURE);
-                }
-                dup2(inputFd, STDIN_FILENO);
-                close(inputFd);
-            }
+    // Check for I/O redirection
+    string inputFile, outputFile;
+    int outputMode;
 
-            // Handle output redirection
-            if (!outputFile.empty()) 
-            {
-                int outputFd = open(outputFile.c_str(), O_WRONLY | O_CREAT | outputMode, 0644);
-                if (outputFd < 0) 
-                {
-                    cerr << "Error: Cannot open output file." << endl;
-                    exit(EXIT_FAILURE);
-                }
-                dup2(outputFd, STDOUT_FILENO);
-                close(outputFd);
-            }
+    // Tokenize the command to check for redirection
+    vector<string> commandTokens = tokenizeWithRedirection(trim(join(command, " ")), inputFile, outputFile, outputMode);
+    applyAssignments(commandTokens, true);
 
-            // Close all pipe file descriptors in child
-            for (int j = 0; j < 2 * numCommands; j++) 
-            {
-                close(pipefds[j]);
-            }
+    // Read from the previous stage and write to the next one
+    if (inputFd >= 0 && dup2(inputFd, STDIN_FILENO) < 0) 
+    {
+        perror("Dup2 input failed");
+        _exit(1);
+    }
+    if (outputFd >= 0 && dup2(outputFd, STDOUT_FILENO) < 0) 
+    {
+        perror("Dup2 output failed");
+        _exit(1);
+    }
 
-            // Prepare arguments for execvp
-            vector<char*> args;
-            for (auto& token : commandTokens) 
-            {
-                args.push_back(const_cast<char*>(token.c_str()));
-            }
-            args.push_back(nullptr); // Null-terminate the argument list
+    // Handle input redirection
+    if (!inputFile.empty()) 
+    {
+        int fd = open(inputFile.c_str(), O_RDONLY);
+        if (fd < 0) 
+        {
+            cerr << "Error: Cannot open input file." << endl;
+            _exit(EXIT_FAILURE);
+        }
+        dup2(fd, STDIN_FILENO);
+        close(fd);
+    }
 
-            // Execute the command using execvp
-            if (execvp(args[0], args.data()) < 0) 
-            {
-                perror("Execvp failed");
-                exit(1);
-            }
+    // Handle output redirection
+    if (!outputFile.empty()) 
+    {
+        int fd = open(outputFile.c_str(), O_WRONLY | O_CREAT | outputMode, 0644);
+        if (fd < 0) 
+        {
+            cerr << "Error: Cannot open output file." << endl;
+            _exit(EXIT_FAILURE);
         }
+        dup2(fd, STDOUT_FILENO);
+        close(fd);
     }
 
-    // Parent process closes all pipe file descriptors
-    for (int i = 0; i < 2 * numCommands; i++) 
+    // Close all pipe file descriptors in child
+    for (int fd : closeFds) 
     {
-        close(pipefds[i]);
+        close(fd);
     }
 
-    // Wait for all child processes
-    for (int i = 0; i < numCommands; i++) 
+    // Builtins run in the stage's own child instead of being exec'd
+    const Builtin* builtin = commandTokens.empty() ? nullptr : findBuiltin(commandTokens[0]);
+    if (builtin != nullptr) 
     {
-        wait(NULL);
+        if (!(builtin->flags & BUILTIN_PIPELINE)) 
+        {
+            cerr << commandTokens[0] << ": cannot be used in a pipeline" << endl;
+            _exit(1);
+        }
+        string stageInput = join(commandTokens, " ");
+        BuiltinContext context = {baseDir, currentDir, stageInput, history, status};
+        removeBuiltinQuotes(builtin, commandTokens);
+        lastExitStatus = 0;
+        bool ok = builtin->handler(commandTokens, context);
+        cout.flush();
+        _exit(ok ? lastExitStatus : 1);
     }
 
-    return true;
+    execTokens(commandTokens);
+    return -1; // Not reached
 }
 
-
-// Function to execute commands
-bool executeCommand(vector<string>& tokens, string& baseDir, string& currentDir, const string& input, vector<string>& history, int& status) 
+// Function to start every stage of a pipeline without waiting; pids gets one entry per stage
+static bool launchPipeline(const vector<vector<string>>& commands, int inputFd, int outputFd, const vector<int>& extraFds, vector<pid_t>& pids, string& baseDir, string& currentDir, vector<string>& history, int& status) 
 {
-    if (tokens.empty()) 
-        return false;
-    
-    string inputFile, outputFile;
-    int outputMode;
+    int numCommands = commands.size();
+    vector<int> pipefds(2 * (numCommands - 1)); // Pipes for communication between processes
 
-    // Tokenize the command and check for redirection
-    auto commandTokens = tokenizeWithRedirection(input, inputFile, outputFile, outputMode);
+    // Create pipes for all processes
+    for (int i = 0; i < numCommands - 1; i++) 
+    {
+        if (pipe(&pipefds[i * 2]) < 0) 
+        {
+            perror("Pipe creation failed");
+            return false;
+        }
+    }
 
-    // If redirection is detected, execute with redirection
-    if (!inputFile.empty() || !outputFile.empty()) 
+    vector<int> closeFds = pipefds;
+    closeFds.insert(closeFds.end(), extraFds.begin(), extraFds.end());
+
+    // With PIN_STAGES=auto each stage gets its own core of one shared cache
+    vector<int> cpus = pipelineCpus(numCommands);
+
+    bool ok = true;
+    for (int i = 0; i < numCommands && ok; i++) 
     {
-        return executeCommandWithRedirection(commandTokens, inputFile, outputFile, outputMode);
+        int stageInput = i > 0 ? pipefds[(i - 1) * 2] : inputFd;
+        int stageOutput = i < numCommands - 1 ? pipefds[i * 2 + 1] : outputFd;
+        pid_t pid = startStage(commands[i], stageInput, stageOutput, closeFds, cpus.empty() ? -1 : cpus[i], baseDir, currentDir, history, status);
+        if (pid < 0) 
+            ok = false;
+        else 
+            pids.push_back(pid);
     }
 
-    if (tokens[0] == "cd") 
+    // Parent process closes all pipe file descriptors
+    for (int fd : pipefds) 
     {
-        string path;
+        close(fd);
+    }
+    return ok;
+}
 
-        if (tokens.size() == 1) 
-        {
-            // No arguments provided, go to baseDir
-            path = baseDir;
-        } 
-        else if (tokens.size() == 2) 
+// Function to wait for the given children; the status is the last one's
+static void waitForStages(const vector<pid_t>& pids) 
+{
+    for (size_t i = 0; i < pids.size(); i++) 
+    {
+        int commstatus;
+        while (waitpid(pids[i], &commstatus, 0) < 0 && errno == EINTR)
+            ;
+        if (i + 1 == pids.size()) 
         {
-            path = tokens[1];
+            lastExitStatus = WIFEXITED(commstatus) ? WEXITSTATUS(commstatus) : 128 + WTERMSIG(commstatus);
+        }
+    }
+}
 
-            if (path == "~") 
-            {
-                path = baseDir;
-            }
-        } 
-        else 
+bool executePipeline(const vector<vector<string>>& commands, string& baseDir, string& currentDir, vector<string>& history, int& status) 
+{
+    vector<pid_t> pids;
+    bool ok = launchPipeline(commands, -1, -1, vector<int>(), pids, baseDir, currentDir, history, status);
+
+    // Wait for all child processes, the pipeline's status is the last stage's
+    waitForStages(pids);
+    return ok;
+}
+
+// Function run by the fan-out duplicator: copy everything from source to every sink.
+// tee(2) duplicates pipe buffers without copying them and splice(2) moves the
+// last copy, so the data never passes through user space unless a tee was short
+static void duplicateStream(int source, vector<int> sinks) 
+{
+    signal(SIGPIPE, SIG_IGN); // A branch that quits early (head) just stops receiving
+    vector<char> buffer;
+
+    while (!sinks.empty()) 
+    {
+        // The last sink gets the data moved; the others get it duplicated first
+        ssize_t length;
+        vector<ssize_t> teed(sinks.size() - 1);
+        if (sinks.size() == 1) 
         {
-            cerr << "cd: too many arguments" << endl;
-            return false;
+            length = splice(source, nullptr, sinks[0], nullptr, 1 << 16, SPLICE_F_MOVE);
+            if (length < 0 && errno == EINTR)
+                continue;
+            if (length < 0 && errno == EPIPE) 
+                break;
+            if (length <= 0) 
+                break;
+            continue;
         }
 
-        if (changeDirectory(path, previousDir)) 
+        length = tee(source, sinks[0], INT_MAX, 0);
+        if (length < 0 && errno == EINTR)
+            continue;
+        if (length < 0 && errno == EPIPE) 
         {
-            return true;
+            close(sinks[0]);
+            sinks.erase(sinks.begin());
+            continue;
         }
+        if (length <= 0) 
+            break; // End of the producer's output
+        teed[0] = length;
 
-        return false;
-    } 
-    else if (tokens[0] == "echo") 
-    {
-        echoPrinting(input);
-        return true;
-    } 
-    else if (tokens[0] == "pwd") 
-    {
-        PresentWorkingDirectory(baseDir);
-        return true;
-    } 
-    else if (tokens[0] == "ls") 
-    {
-        bool all = false;
-        bool longformat = false;
-        string path = currentDir;
+        bool shortTee = false;
+        for (size_t i = 1; i + 1 < sinks.size(); i++) 
+        {
+            ssize_t count;
+            while ((count = tee(source, sinks[i], length, 0)) < 0 && errno == EINTR)
+                ;
+            teed[i] = count < 0 ? -1 : count;
+            shortTee = shortTee || teed[i] != length;
+        }
 
-        vector<string> paths;
-        for (long unsigned int i = 1; i < tokens.size(); i++) 
+        if (!shortTee) 
         {
-            if (tokens[i] == "-a")
-                all = true;
-            else if (tokens[i] == "-l")
-                longformat = true;
-            else if (tokens[i] == "-la" || tokens[i] == "-al") 
+            // Every duplicate is complete: move the bytes themselves to the last sink
+            ssize_t moved = 0;
+            while (moved < length) 
             {
-                all = true;
-                longformat = true;
+                ssize_t count = splice(source, nullptr, sinks.back(), nullptr, length - moved, SPLICE_F_MOVE);
+                if (count < 0 && errno == EINTR)
+                    continue;
+                if (count <= 0) 
+                    break;
+                moved += count;
             }
-            else if (tokens[i].front() != '-') 
+            if (moved < length) 
             {
-                path = tokens[i];
-                if (path == "~") 
-                {
-                    path = baseDir;
-                }
-                paths.push_back(path);
+                // The last sink is gone; drop what it did not take
+                buffer.resize(length - moved);
+                if (read(source, buffer.data(), buffer.size()) < 0)
+                    break;
+                close(sinks.back());
+                sinks.pop_back();
             }
+            continue;
         }
 
-        if (paths.size() > 1) 
+        // A sink took less than the rest: consume the bytes and finish each sink with a copy
+        buffer.resize(length);
+        ssize_t got = 0;
+        while (got < length) 
         {
-            for (auto path : paths) 
-            {
-                cout << path << ": " << endl;
-                listing(path, all, longformat);
-                cout << endl;
-            }
-            return true;
-        } 
-        else 
+            ssize_t count = read(source, buffer.data() + got, length - got);
+            if (count < 0 && errno == EINTR)
+                continue;
+            if (count <= 0) 
+                break;
+            got += count;
+        }
+        teed.push_back(0); // The last sink has received nothing of this chunk yet
+        for (size_t i = 0; i < sinks.size(); i++) 
         {
-            if (path == "~") 
+            ssize_t offset = teed[i];
+            while (offset >= 0 && offset < got) 
             {
-                path = baseDir;
+                ssize_t count = write(sinks[i], buffer.data() + offset, got - offset);
+                if (count < 0 && errno == EINTR)
+                    continue;
+                if (count <= 0) 
+                {
+                    offset = -1;
+                    break;
+                }
+                offset += count;
             }
-
-            if (longformat) 
+            if (offset < 0) 
             {
-                // Calculate total block size before listing
-                long totalBlocks = calculateTotalBlocks(path, all);
-                cout << "total " << totalBlocks << endl;
+                close(sinks[i]);
+                sinks[i] = -1;
             }
-
-            return listing(path, all, longformat);
         }
+        sinks.erase(remove(sinks.begin(), sinks.end(), -1), sinks.end());
     }
+}
 
-
-    else if (tokens[0] == "pinfo") 
+// Function to run `producer |& { branch ; branch ... }`: each branch pipeline reads its own copy of the output
+bool executeFanOut(const vector<vector<string>>& producer, const vector<vector<vector<string>>>& branches, string& baseDir, string& currentDir, vector<string>& history, int& status) 
+{
+    // Branches are started first so that each child can be told about every pipe end
+    int source[2];
+    if (pipe2(source, O_CLOEXEC) < 0) 
     {
-        // Check if a PID is provided
-        int pid;
-        if (tokens.size() == 2) 
-        {
-            pid = stoi(tokens[1]);
-        } 
-        else 
-        {
-            // Use the shell's own PID if no PID is provided
-            pid = getpid();
-        }
-
-        // Call the pinfo function with the specified PID
-        pinfo(pid);
-        return true;
+        perror("Pipe creation failed");
+        return false;
     }
-    else if (tokens[0] == "search") 
+    vector<int> branchPipes(2 * branches.size());
+    for (size_t i = 0; i < branches.size(); i++) 
     {
-        if (tokens.size() != 2) 
+        if (pipe2(&branchPipes[i * 2], O_CLOEXEC) < 0) 
         {
-            cerr << "search: missing argument" << endl;
+            perror("Pipe creation failed");
+            close(source[0]);
+            close(source[1]);
+            for (size_t j = 0; j < i * 2; j++) 
+                close(branchPipes[j]);
             return false;
         }
-        string target = tokens[1];
+    }
+    vector<int> allFds = branchPipes;
+    allFds.push_back(source[0]);
+    allFds.push_back(source[1]);
 
-        if(search(currentDir, target) == true)
-            cout << "True" << endl;
-        else
-            cout << "False" << endl;
-        
-        return true;
+    vector<pid_t> producerPids, branchPids, lastStages;
+    bool ok = launchPipeline(producer, -1, source[1], allFds, producerPids, baseDir, currentDir, history, status);
+    for (size_t i = 0; i < branches.size() && ok; i++) 
+    {
+        vector<pid_t> pids;
+        ok = launchPipeline(branches[i], branchPipes[i * 2], -1, allFds, pids, baseDir, currentDir, history, status);
+        branchPids.insert(branchPids.end(), pids.begin(), pids.end());
+        if (!pids.empty()) 
+            lastStages.push_back(pids.back());
     }
-    else if (tokens[0] == "history") 
+
+    pid_t duplicator = ok ? fork() : -1;
+    if (duplicator == 0) 
     {
-        if(tokens.size() == 1)
+        vector<int> sinks;
+        for (size_t i = 0; i < branches.size(); i++) 
         {
-            displayHistory(history, 0);
+            close(branchPipes[i * 2]);
+            sinks.push_back(branchPipes[i * 2 + 1]);
         }
-        else
+        close(source[1]);
+        duplicateStream(source[0], sinks);
+        _exit(0);
+    }
+
+    for (int fd : allFds) 
+    {
+        close(fd);
+    }
+    if (duplicator > 0) 
+        branchPids.push_back(duplicator);
+
+    // Each branch is a result of its own, so the line fails if any branch does, with the
+    // status of the rightmost failing one as under bash's pipefail
+    waitForStages(producerPids);
+    int branchStatus = lastStages.empty() ? lastExitStatus : 0;
+    for (pid_t pid : branchPids) 
+    {
+        int commstatus;
+        while (waitpid(pid, &commstatus, 0) < 0 && errno == EINTR)
+            ;
+        if (find(lastStages.begin(), lastStages.end(), pid) == lastStages.end()) 
+            continue;
+        int code = WIFEXITED(commstatus) ? WEXITSTATUS(commstatus) : 128 + WTERMSIG(commstatus);
+        if (code != 0) 
+            branchStatus = code;
+    }
+    lastExitStatus = branchStatus;
+    return ok;
+}
+
+
+// Function to execute commands
+bool executeCommand(vector<string>& tokens, string& baseDir, string& currentDir, const string& input, vector<string>& history, int& status) 
+{
+    if (tokens.empty()) 
+        return false;
+    
+    string inputFile, outputFile;
+    int outputMode;
+
+    // NAME=value words in front of a command only apply to that command
+    applyAssignments(tokens, true);
+    if (tokens.empty()) 
+        return true;
+
+    // Tokenize the command and check for redirection
+    auto commandTokens = tokenizeWithRedirection(input, inputFile, outputFile, outputMode);
+    applyAssignments(commandTokens, true);
+    expandGlobs(commandTokens);
+
+    BuiltinContext context = {baseDir, currentDir, input, history, status};
+    const Builtin* builtin = findBuiltin(tokens[0]);
+
+    // If redirection is detected, execute with redirection
+    if (!inputFile.empty() || !outputFile.empty()) 
+    {
+        if (builtin != nullptr) 
         {
-            // cout << "Size of array: " << history.size() << endl;
-            displayHistory(history, stoi(tokens[1]));
+            removeBuiltinQuotes(builtin, commandTokens);
+            return runBuiltinRedirected(builtin, commandTokens, context, inputFile, outputFile, outputMode);
         }
-        return true;
+        return executeCommandWithRedirection(commandTokens, inputFile, outputFile, outputMode);
     }
-    else if (tokens[0] == "exit") 
+
+    if (builtin != nullptr) 
     {
-        status = 0;
-        return true;
+        removeBuiltinQuotes(builtin, tokens);
+        return builtin->handler(tokens, context);
     }
     else 
     {
@@ -517,6 +795,15 @@ bool executeCommand(vector<string>& tokens, string& baseDir, string& currentDir,
             tokens.pop_back();
         }
 
+        // Commands listed in $CACHE_COMMANDS replay their last result while their inputs are unchanged
+        if (!isbg && isAutoCached(tokens[0]))
+        {
+            vector<string> words;
+            for (const string& token : tokens) 
+                words.push_back(removeQuotes(token));
+            return runCachedCommand(words, autoCacheTtl(), vector<string>(), context);
+        }
+
         pid_t ppid = fork();
         if(ppid < 0)
         {
@@ -526,18 +813,7 @@ bool executeCommand(vector<string>& tokens, string& baseDir, string& currentDir,
         
         else if(ppid == 0)
         {
-            vector<char*> args;
-            for (auto& token : tokens) 
-            {
-                args.push_back(const_cast<char*>(token.c_str()));
-            }
-            args.push_back(nullptr);
-
-            if (execvp(args[0], args.data()) == -1) 
-            {
-                perror("Error executing command");
-                exit(EXIT_FAILURE); // Exit the child process with an error status
-            }
+            execTokens(tokens);
         }
 
         else
@@ -560,6 +836,7 @@ bool executeCommand(vector<string>& tokens, string& baseDir, string& currentDir,
 
                 if (WIFEXITED(commstatus)) 
                 {
+                    lastExitStatus = WEXITSTATUS(commstatus);
                     if (WEXITSTATUS(commstatus) != 0) 
                     {
                         cerr << "Command failed with exit status " << WEXITSTATUS(commstatus) << endl;
@@ -567,7 +844,10 @@ bool executeCommand(vector<string>& tokens, string& baseDir, string& currentDir,
                 } 
                 else 
                 {
-                    cerr << "Command did not exit normally" << endl;
+                    lastExitStatus = 128 + WTERMSIG(commstatus);
+                    // A reader that stopped early (head, or a consumer of <(...)) is not worth a message
+                    if (WTERMSIG(commstatus) != SIGPIPE)
+                        cerr << "Command did not exit normally" << endl;
                 }
                 
             }
@@ -578,4 +858,213 @@ bool executeCommand(vector<string>& tokens, string& baseDir, string& currentDir,
     return true;
 }
 
+// Function to run a single external command cloned from the zygote, reporting its status as
+// executeCommand would; returns false if it must be forked instead (see spawnExternal), and
+// for `&` and commands with cached results
+static bool runFromZygote(const vector<string>& tokens, const string& command) 
+{
+    if (!zygoteAvailable() || isAssignment(tokens[0]) || findBuiltin(tokens[0]) != nullptr || tokens.back() == "&" || isAutoCached(tokens[0])) 
+        return false;
+
+    string inputFile, outputFile;
+    int outputMode;
+    vector<string> commandTokens = tokenizeWithRedirection(command, inputFile, outputFile, outputMode);
+    bool redirected = !inputFile.empty() || !outputFile.empty();
+    if (redirected) 
+        expandGlobs(commandTokens);
+    pid_t pid = spawnExternal(redirected ? commandTokens : tokens, inputFile, outputFile, outputMode, -1, -1, -1);
+    if (pid < 0) 
+        return false;
+
+    foregroundPid = pid;
+    int commstatus;
+    while (waitpid(pid, &commstatus, 0) < 0 && errno == EINTR)
+        ;
+    foregroundPid = -1;
+
+    if (WIFEXITED(commstatus)) 
+    {
+        lastExitStatus = WEXITSTATUS(commstatus);
+        if (lastExitStatus != 0 && !redirected) 
+            cerr << "Command failed with exit status " << lastExitStatus << endl;
+    } 
+    else 
+    {
+        lastExitStatus = 128 + WTERMSIG(commstatus);
+        if (WTERMSIG(commstatus) != SIGPIPE && !redirected) 
+            cerr << "Command did not exit normally" << endl;
+    }
+    return true;
+}
 
+// Function to expand substitutions and globs in, and tokenize, each command of a pipeline;
+// returns false if an expansion failed, and then no stage may run
+static bool prepareStages(const vector<string>& pipeCommands, vector<vector<string>>& stages, string& baseDir, string& currentDir, vector<string>& history, int& status) 
+{
+    for (auto& cmd : pipeCommands) 
+    {
+        string expanded;
+        if (!expandCommandLine(cmd, expanded, baseDir, currentDir, history, status)) 
+            return false;
+        stages.push_back(tokenize(expanded));
+        expandGlobs(stages.back());
+    }
+    return true;
+}
+
+// Function to run one line of input: semicolon separated commands, each possibly a pipeline
+void executeInputLine(const string& input, string& baseDir, string& currentDir, vector<string>& history, int& status)
+{
+    // Scratch memory used while the line runs is given back in one step when it returns
+    ArenaScope line;
+
+    // Tokenize by semicolon first
+    vector<string> commandList = tokenizeBySemicolon(input);
+
+    // Rebuild envp here if exports changed, so every child below reuses the parent's copy
+    exportedEnvironment();
+
+    // Process each command in the command list (semicolon-separated)
+    for (long unsigned int i = 0; i < commandList.size(); i++) 
+    {
+        // <(...) and >(...) of the previous command stay open only until it has finished
+        finishProcessSubstitutions();
+
+        // The previous command may have changed directory or files: glob listings start afresh
+        resetGlobCache();
+        string command = commandList[i];
+
+        // Tokenize by pipe for piped commands
+        vector<string> pipeCommands = tokenizeByPipe(command);
+
+        // `cmd |& { a ; b }` splits as a last stage beginning with "&"
+        if (pipeCommands.size() > 1 && pipeCommands.back()[0] == '&') 
+        {
+            string group = trim(pipeCommands.back().substr(1));
+            pipeCommands.pop_back();
+            if (group.size() < 2 || group.front() != '{' || group.back() != '}') 
+            {
+                cerr << "syntax error: |& must be followed by { pipeline ; pipeline ... }" << endl;
+                lastExitStatus = 2;
+                continue;
+            }
+
+            vector<vector<vector<string>>> branches;
+            bool expanded = true;
+            for (auto& branch : tokenizeBySemicolon(group.substr(1, group.size() - 2))) 
+            {
+                if (!branch.empty() && expanded) 
+                {
+                    branches.push_back(vector<vector<string>>());
+                    expanded = prepareStages(tokenizeByPipe(branch), branches.back(), baseDir, currentDir, history, status);
+                }
+            }
+            vector<vector<string>> producer;
+            if (!expanded || !prepareStages(pipeCommands, producer, baseDir, currentDir, history, status)) 
+            {
+                lastExitStatus = 1;
+                continue;
+            }
+            if (branches.empty() || !executeFanOut(producer, branches, baseDir, currentDir, history, status)) 
+            {
+                cerr << "Failed to execute pipeline" << endl;
+            }
+        } 
+        else if (pipeCommands.size() > 1) 
+        {
+            // If the command contains pipes, handle the pipeline
+            vector<vector<string>> commandTokens;
+            if (!prepareStages(pipeCommands, commandTokens, baseDir, currentDir, history, status)) 
+            {
+                lastExitStatus = 1;
+                continue;
+            }
+
+            // Execute the piped commands
+            if (!executePipeline(commandTokens, baseDir, currentDir, history, status)) 
+            {
+                cerr << "Failed to execute pipeline" << endl;
+            }
+        } 
+        else 
+        {
+            // No pipe, treat it as a single command
+            // A failed $((...)) expansion aborts the command, as in bash
+            if (!expandCommandLine(command, command, baseDir, currentDir, history, status)) 
+            {
+                lastExitStatus = 1;
+                continue;
+            }
+            vector<string> singleCommandTokens = tokenize(command);
+            if (singleCommandTokens.empty()) 
+            {
+                continue;
+            }
+            expandGlobs(singleCommandTokens);
+
+            // The command word comes after any NAME=value words
+            size_t commandWord = 0;
+            while (commandWord < singleCommandTokens.size() && isAssignment(singleCommandTokens[commandWord])) 
+                commandWord++;
+            const Builtin* builtin = commandWord < singleCommandTokens.size() ? findBuiltin(singleCommandTokens[commandWord]) : nullptr;
+
+            // A line of only NAME=value words sets shell variables
+            if (isAssignmentOnly(singleCommandTokens)) 
+            {
+                applyAssignments(singleCommandTokens, false);
+                lastExitStatus = 0;
+            }
+            // Builtins that change shell state (cd, export, exit, ...) run in the parent process
+            else if (builtin != nullptr && (builtin->flags & BUILTIN_PARENT)) 
+            {
+                // Execute the builtin in the parent process; NAME=value words only apply while it runs
+                vector<VariableChange> saved;
+                for (size_t j = 0; j < commandWord; j++) 
+                    saved.push_back(saveVariable(singleCommandTokens[j].substr(0, singleCommandTokens[j].find('='))));
+                string name = singleCommandTokens[commandWord];
+                lastExitStatus = 0;
+                if (!executeCommand(singleCommandTokens, baseDir, currentDir, command, history, status)) 
+                {
+                    lastExitStatus = 1;
+                    cerr << "Failed to execute " << name << " command" << endl;
+                }
+                for (auto it = saved.rbegin(); it != saved.rend(); ++it) 
+                    restoreVariable(*it);
+            }
+            // External commands are cloned from the zygote, so the shell's size does not slow them
+            else if (!runFromZygote(singleCommandTokens, command)) 
+            {
+                // Set the foreground process ID before executing
+                foregroundPid = fork();
+                if (foregroundPid == 0) 
+                {
+                    // In child process
+                    lastExitStatus = 0;
+                    if (!executeCommand(singleCommandTokens, baseDir, currentDir, command, history, status)) 
+                    {
+                        cerr << "Failed to execute command" << endl;
+                        cout.flush();
+                        _exit(1);
+                    }
+                    // _exit so the child never rewinds the stdin offset it shares with the shell
+                    cout.flush();
+                    _exit(lastExitStatus); // Exit child process with the command's status
+                } 
+                else 
+                {
+                    // In parent process, wait for the foreground process
+                    int commstatus;
+                    waitpid(foregroundPid, &commstatus, 0);
+                    lastExitStatus = WIFEXITED(commstatus) ? WEXITSTATUS(commstatus) : 128 + WTERMSIG(commstatus);
+                    foregroundPid = -1; // Reset foreground process ID
+                }
+            }
+
+            if (status == 0) 
+            {
+                break; // Exit the shell loop if `exit` was called
+            }
+        }
+    }
+    finishProcessSubstitutions();
+}
@@ -6,19 +6,31 @@
 #include <sstream>
 #include <algorithm>
 #include <cctype>
+#include <sys/types.h>
 
 using namespace std;
 
+struct BuiltinContext;
+
+extern pid_t foregroundPid;
+extern int lastExitStatus;
+extern string previousDir;
+
 // Function declarations
 long calculateTotalBlocks(const string& path, bool includeHidden);
 string trim(const string& str);
+vector<string> splitTopLevel(const string& input, char separator);
 vector<string> tokenizeByPipe(const string& input);
 vector<string> tokenizeBySemicolon(const string& input);
 vector<string> tokenize(const string& input);
 string join(const vector<string>& tokens, const string& delimiter);
+void execTokens(const vector<string>& tokens);
+int runWords(vector<string>& words, BuiltinContext& context);
 vector<string> tokenizeWithRedirection(const string& input, string& inputFile, string& outputFile, int& outputMode);
 bool executeCommandWithRedirection(const vector<string>& tokens, const string& inputFile, const string& outputFile, int outputMode);
 bool executePipeline(const vector<vector<string>>& commands, string& baseDir, string& currentDir, vector<string>& history, int& status);
+bool executeFanOut(const vector<vector<string>>& producer, const vector<vector<vector<string>>>& branches, string& baseDir, string& currentDir, vector<string>& history, int& status);
 bool executeCommand(vector<string>& tokens, string& baseDir, string& currentDir, const string& input, vector<string>& history, int& status);
+void executeInputLine(const string& input, string& baseDir, string& currentDir, vector<string>& history, int& status);
 
 #endif // SHELL_H
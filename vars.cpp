@@ -0,0 +1,429 @@
+#include "vars.h"
+#include <iostream>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+
+using namespace std;
+
+extern char** environ;
+
+// Variable names are interned: each distinct name is copied once into a
+// chunk of the pool and every slot refers to it by pointer
+class InternPool
+{
+public:
+    const char* intern(const string& name)
+    {
+        size_t needed = name.size() + 1;
+        if (chunks.empty() || used + needed > chunkSize)
+        {
+            size_t size = needed > chunkSize ? needed : (size_t)chunkSize;
+            chunks.push_back(unique_ptr<char[]>(new char[size]));
+            used = 0;
+        }
+        char* copy = chunks.back().get() + used;
+        memcpy(copy, name.c_str(), needed);
+        used += needed;
+        return copy;
+    }
+
+private:
+    static const size_t chunkSize = 4096;
+    vector<unique_ptr<char[]>> chunks;
+    size_t used = 0;
+};
+
+enum SlotState { SLOT_EMPTY, SLOT_USED, SLOT_DELETED };
+
+struct VarSlot
+{
+    SlotState state = SLOT_EMPTY;
+    uint32_t hash = 0;
+    const char* name = nullptr; // Interned
+    size_t nameLength = 0;
+    string value;
+    bool exported = false;
+};
+
+// Open addressing table with linear probing, kept under 70% load
+static vector<VarSlot> slots;
+static size_t liveCount = 0;   // Used slots
+static size_t filledCount = 0; // Used + deleted slots, what the probe sequences see
+static InternPool names;
+static bool initialized = false;
+
+// Changes made while journaling is on, for the server to carry across a session's commands
+static bool journaling = false;
+static vector<VariableChange> journal;
+
+// envp handed to execvpe, rebuilt only after an exported variable changes
+static vector<string> envStrings;
+static vector<char*> envPointers;
+static bool envDirty = true;
+
+static uint32_t hashName(const char* name, size_t length)
+{
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Function to find the slot holding name, or the slot where it would be inserted
+static size_t probe(const char* name, size_t length, uint32_t hash, bool& found)
+{
+    size_t mask = slots.size() - 1;
+    size_t index = hash & mask;
+    size_t firstDeleted = SIZE_MAX;
+    found = false;
+
+    while (true)
+    {
+        VarSlot& slot = slots[index];
+        if (slot.state == SLOT_EMPTY)
+            return firstDeleted != SIZE_MAX ? firstDeleted : index;
+        if (slot.state == SLOT_DELETED)
+        {
+            if (firstDeleted == SIZE_MAX)
+                firstDeleted = index;
+        }
+        else if (slot.hash == hash && slot.nameLength == length && memcmp(slot.name, name, length) == 0)
+        {
+            found = true;
+            return index;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+static void rehash(size_t capacity)
+{
+    vector<VarSlot> old;
+    old.swap(slots);
+    slots.resize(capacity);
+    liveCount = filledCount = 0;
+
+    for (auto& slot : old)
+    {
+        if (slot.state != SLOT_USED)
+            continue;
+        bool found;
+        size_t index = probe(slot.name, slot.nameLength, slot.hash, found);
+        slots[index] = move(slot);
+        liveCount++;
+        filledCount++;
+    }
+}
+
+static VarSlot* findSlot(const string& name)
+{
+    if (slots.empty())
+        return nullptr;
+    bool found;
+    size_t index = probe(name.data(), name.size(), hashName(name.data(), name.size()), found);
+    return found ? &slots[index] : nullptr;
+}
+
+static VarSlot& insertSlot(const string& name)
+{
+    if ((filledCount + 1) * 10 > slots.size() * 7)
+    {
+        // Double when genuinely full, otherwise just sweep out the tombstones
+        size_t capacity = slots.size();
+        if ((liveCount + 1) * 10 > capacity * 5)
+            capacity *= 2;
+        rehash(max<size_t>(64, capacity));
+    }
+
+    uint32_t hash = hashName(name.data(), name.size());
+    bool found;
+    size_t index = probe(name.data(), name.size(), hash, found);
+    VarSlot& slot = slots[index];
+    if (!found)
+    {
+        if (slot.state == SLOT_EMPTY)
+            filledCount++;
+        liveCount++;
+        slot.state = SLOT_USED;
+        // A tombstone left by unset of the same name still holds its interned copy
+        bool sameName = slot.name != nullptr && slot.hash == hash && slot.nameLength == name.size() &&
+                        memcmp(slot.name, name.data(), name.size()) == 0;
+        slot.hash = hash;
+        if (!sameName)
+            slot.name = names.intern(name);
+        slot.nameLength = name.size();
+        slot.value.clear();
+        slot.exported = false;
+    }
+    return slot;
+}
+
+// Function to import the inherited environment the first time variables are used
+static void ensureInitialized()
+{
+    if (initialized)
+        return;
+    initialized = true;
+    rehash(256);
+    for (char** entry = environ; entry && *entry; entry++)
+    {
+        const char* equals = strchr(*entry, '=');
+        if (equals == nullptr)
+            continue;
+        VarSlot& slot = insertSlot(string(*entry, equals - *entry));
+        slot.value = equals + 1;
+        slot.exported = true;
+    }
+}
+
+const string* lookupVariable(const string& name)
+{
+    ensureInitialized();
+    VarSlot* slot = findSlot(name);
+    return slot ? &slot->value : nullptr;
+}
+
+void setVariable(const string& name, const string& value, bool exported)
+{
+    ensureInitialized();
+    VarSlot& slot = insertSlot(name);
+    slot.value = value;
+    slot.exported = slot.exported || exported;
+    if (journaling)
+        journal.push_back({name, value, slot.exported, false});
+    if (slot.exported)
+    {
+        envDirty = true;
+        // execvpe searches the shell's own PATH, so keep that one in sync
+        if (name == "PATH")
+            setenv("PATH", value.c_str(), 1);
+    }
+}
+
+void exportVariable(const string& name)
+{
+    ensureInitialized();
+    VarSlot& slot = insertSlot(name);
+    if (journaling)
+        journal.push_back({name, slot.value, true, false});
+    if (!slot.exported)
+    {
+        slot.exported = true;
+        envDirty = true;
+        if (name == "PATH")
+            setenv("PATH", slot.value.c_str(), 1);
+    }
+}
+
+void unsetVariable(const string& name)
+{
+    ensureInitialized();
+    VarSlot* slot = findSlot(name);
+    if (slot == nullptr)
+        return;
+    if (journaling)
+        journal.push_back({name, "", false, true});
+    if (slot->exported)
+        envDirty = true;
+    slot->state = SLOT_DELETED;
+    slot->value.clear();
+    slot->exported = false;
+    liveCount--;
+    if (name == "PATH")
+        unsetenv("PATH");
+}
+
+// Function to record how name is set now, so that restoreVariable can put it back
+VariableChange saveVariable(const string& name)
+{
+    ensureInitialized();
+    VarSlot* slot = findSlot(name);
+    if (slot == nullptr)
+        return {name, "", false, true};
+    return {name, slot->value, slot->exported, false};
+}
+
+void restoreVariable(const VariableChange& saved)
+{
+    if (saved.unset)
+    {
+        unsetVariable(saved.name);
+        return;
+    }
+    VarSlot& slot = insertSlot(saved.name);
+    if (slot.exported || saved.exported)
+        envDirty = true;
+    slot.value = saved.value;
+    slot.exported = saved.exported;
+    if (journaling)
+        journal.push_back(saved);
+    if (saved.name == "PATH")
+    {
+        if (saved.exported)
+            setenv("PATH", saved.value.c_str(), 1);
+        else
+            unsetenv("PATH");
+    }
+}
+
+void journalVariableChanges(bool enabled)
+{
+    journaling = enabled;
+    journal.clear();
+}
+
+const vector<VariableChange>& variableJournal()
+{
+    return journal;
+}
+
+// Function to return the envp for new commands, rebuilding it only when exports changed
+char** exportedEnvironment()
+{
+    ensureInitialized();
+    if (envDirty)
+    {
+        envStrings.clear();
+        for (auto& slot : slots)
+        {
+            if (slot.state == SLOT_USED && slot.exported)
+                envStrings.push_back(string(slot.name, slot.nameLength) + "=" + slot.value);
+        }
+        envPointers.clear();
+        for (auto& entry : envStrings)
+            envPointers.push_back(const_cast<char*>(entry.c_str()));
+        envPointers.push_back(nullptr);
+        envDirty = false;
+    }
+    return envPointers.data();
+}
+
+bool isValidVariableName(const string& name)
+{
+    if (name.empty() || isdigit((unsigned char)name[0]))
+        return false;
+    for (char c : name)
+    {
+        if (!isalnum((unsigned char)c) && c != '_')
+            return false;
+    }
+    return true;
+}
+
+bool isAssignment(const string& token)
+{
+    size_t equals = token.find('=');
+    return equals != string::npos && isValidVariableName(token.substr(0, equals));
+}
+
+bool isAssignmentOnly(const vector<string>& tokens)
+{
+    if (tokens.empty())
+        return false;
+    for (auto& token : tokens)
+    {
+        if (!isAssignment(token))
+            return false;
+    }
+    return true;
+}
+
+// Function to remove the quotes of a word: what is inside '...' or "..." is kept as it is
+string removeQuotes(const string& word)
+{
+    if (word.find_first_of("'\"") == string::npos)
+        return word;
+    string result;
+    char quote = 0;
+    for (char c : word)
+    {
+        if (quote != 0 && c == quote)
+            quote = 0;
+        else if (quote == 0 && (c == '\'' || c == '"'))
+            quote = c;
+        else
+            result += c;
+    }
+    return result;
+}
+
+// Function to quote a word that holds whitespace or characters that are shell syntax, so that
+// it reads back as the same one word; removeQuotes undoes it
+string quoteWord(const string& word)
+{
+    if (word.find_first_of("'\"<>&;| \t\n") == string::npos)
+        return word;
+    if (word.find('\'') == string::npos)
+        return "'" + word + "'";
+    if (word.find('"') == string::npos)
+        return "\"" + word + "\"";
+    string quoted = "'";
+    for (char c : word)
+        quoted += c == '\'' ? string("'\"'\"'") : string(1, c);
+    return quoted + "'";
+}
+
+// Function to apply and remove the leading NAME=value words of a command
+void applyAssignments(vector<string>& tokens, bool exported)
+{
+    size_t count = 0;
+    while (count < tokens.size() && isAssignment(tokens[count]))
+    {
+        size_t equals = tokens[count].find('=');
+        setVariable(tokens[count].substr(0, equals), removeQuotes(tokens[count].substr(equals + 1)), exported);
+        count++;
+    }
+    tokens.erase(tokens.begin(), tokens.begin() + count);
+}
+
+bool runExport(const vector<string>& tokens)
+{
+    ensureInitialized();
+    if (tokens.size() == 1)
+    {
+        vector<string> listing;
+        for (auto& slot : slots)
+        {
+            if (slot.state == SLOT_USED && slot.exported)
+                listing.push_back(string(slot.name, slot.nameLength) + "=\"" + slot.value + "\"");
+        }
+        sort(listing.begin(), listing.end());
+        for (auto& line : listing)
+            cout << "export " << line << endl;
+        return true;
+    }
+
+    bool ok = true;
+    for (size_t i = 1; i < tokens.size(); i++)
+    {
+        size_t equals = tokens[i].find('=');
+        string name = tokens[i].substr(0, equals);
+        if (!isValidVariableName(name))
+        {
+            cerr << "export: `" << tokens[i] << "': not a valid identifier" << endl;
+            ok = false;
+            continue;
+        }
+        // Like every builtin, export gets its words with the quotes already removed
+        if (equals != string::npos)
+            setVariable(name, tokens[i].substr(equals + 1), true);
+        else
+            exportVariable(name);
+    }
+    return ok;
+}
+
+bool runUnset(const vector<string>& tokens)
+{
+    for (size_t i = 1; i < tokens.size(); i++)
+    {
+        unsetVariable(tokens[i]);
+    }
+    return true;
+}
@@ -0,0 +1,37 @@
+#ifndef VARS_H
+#define VARS_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// One set, export or unset, as recorded by the variable journal
+struct VariableChange
+{
+    string name;
+    string value;
+    bool exported;
+    bool unset;
+};
+
+// Function declarations
+const string* lookupVariable(const string& name);
+void setVariable(const string& name, const string& value, bool exported);
+void exportVariable(const string& name);
+void unsetVariable(const string& name);
+VariableChange saveVariable(const string& name);
+void restoreVariable(const VariableChange& saved);
+char** exportedEnvironment();
+void journalVariableChanges(bool enabled);
+const vector<VariableChange>& variableJournal();
+bool isValidVariableName(const string& name);
+bool isAssignment(const string& token);
+string removeQuotes(const string& word);
+string quoteWord(const string& word);
+bool isAssignmentOnly(const vector<string>& tokens);
+void applyAssignments(vector<string>& tokens, bool exported);
+bool runExport(const vector<string>& tokens);
+bool runUnset(const vector<string>& tokens);
+
+#endif // VARS_H
@@ -0,0 +1,356 @@
+#include "watch.h"
+#include "shell.h"
+#include <iostream>
+#include <map>
+#include <set>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <ctime>
+#include <csignal>
+#include <unistd.h>
+#include <poll.h>
+#include <dirent.h>
+#include <sys/inotify.h>
+#include <sys/timerfd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+
+using namespace std;
+
+static const uint32_t watchMask = IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF;
+
+// Both builtins loop until Ctrl-C, which only sets this flag so the loop can clean up
+static volatile sig_atomic_t interrupted = 0;
+
+static void handleInterrupt(int)
+{
+    interrupted = 1;
+}
+
+static void catchInterrupt()
+{
+    interrupted = 0;
+    struct sigaction sa = {};
+    sa.sa_handler = handleInterrupt;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0; // No SA_RESTART: poll must return so the loop sees the flag
+    sigaction(SIGINT, &sa, nullptr);
+}
+
+// Function to start a command line with the shell's own executor, in its own process group
+static pid_t startRun(const string& command, BuiltinContext& context)
+{
+    cout.flush();
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0)
+    {
+        setpgid(0, 0);
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        int status = 1;
+        executeInputLine(command, context.baseDir, context.currentDir, context.history, status);
+        cout.flush();
+        _exit(lastExitStatus);
+    }
+    setpgid(pid, pid);
+    return pid;
+}
+
+static void finishRun(pid_t pid)
+{
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+        ;
+    lastExitStatus = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+// Function to stop a run that is still going, with its whole pipeline
+static void cancelRun(pid_t pid)
+{
+    kill(-pid, SIGTERM);
+    finishRun(pid);
+}
+
+// Function to get an fd that becomes readable when the child exits, or -1 without pidfd support
+static int openPidFd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+    return syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    return -1;
+#endif
+}
+
+struct WatchSet
+{
+    int fd;
+    map<int, string> directories;    // wd -> path, for adding new subdirectories
+    map<int, set<string>> fileNames; // wd -> names of interest; absent means every name
+};
+
+// Function to watch a directory and everything below it
+static void watchTree(WatchSet& watches, const string& path)
+{
+    int wd = inotify_add_watch(watches.fd, path.c_str(), watchMask | IN_ONLYDIR);
+    if (wd < 0)
+    {
+        cerr << "on-change: " << path << ": " << strerror(errno) << endl;
+        return;
+    }
+    watches.directories[wd] = path;
+    watches.fileNames.erase(wd);
+
+    DIR* dir = opendir(path.c_str());
+    if (dir == nullptr)
+        return;
+    while (dirent* entry = readdir(dir))
+    {
+        string name = entry->d_name;
+        if (name == "." || name == ".." || name == ".git")
+            continue;
+        string child = path + "/" + name;
+        struct stat info;
+        if (entry->d_type == DT_DIR || (entry->d_type == DT_UNKNOWN && lstat(child.c_str(), &info) == 0 && S_ISDIR(info.st_mode)))
+            watchTree(watches, child);
+    }
+    closedir(dir);
+}
+
+// Function to watch a file through its directory, so editors that replace the file by rename are seen
+static bool watchFile(WatchSet& watches, const string& path)
+{
+    size_t slash = path.rfind('/');
+    string dir = slash == string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    string name = slash == string::npos ? path : path.substr(slash + 1);
+    int wd = inotify_add_watch(watches.fd, dir.c_str(), watchMask | IN_ONLYDIR);
+    if (wd < 0)
+    {
+        cerr << "on-change: " << path << ": " << strerror(errno) << endl;
+        return false;
+    }
+    if (!watches.directories.count(wd))
+        watches.fileNames[wd].insert(name);
+    return true;
+}
+
+// Function to drain inotify; returns true if any event is one the user asked about
+static bool readEvents(WatchSet& watches)
+{
+    alignas(inotify_event) char buffer[16384];
+    bool relevant = false;
+    while (true)
+    {
+        ssize_t length = read(watches.fd, buffer, sizeof(buffer));
+        if (length <= 0)
+            return relevant;
+        for (char* p = buffer; p < buffer + length;)
+        {
+            inotify_event* event = (inotify_event*)p;
+            p += sizeof(inotify_event) + event->len;
+            string name = event->len ? event->name : "";
+
+            // The queue overflowed and events were lost: any of them may have been relevant
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                relevant = true;
+                continue;
+            }
+            auto files = watches.fileNames.find(event->wd);
+            if (files != watches.fileNames.end())
+            {
+                if (files->second.count(name))
+                    relevant = true;
+                continue;
+            }
+            auto dir = watches.directories.find(event->wd);
+            if (dir == watches.directories.end())
+                continue;
+            if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+                watchTree(watches, dir->second + "/" + name);
+            if (event->mask & IN_IGNORED)
+                watches.directories.erase(dir);
+            relevant = true;
+        }
+    }
+}
+
+// Function to implement `on-change [-d ms] PATH... -- cmd`
+bool runOnChange(vector<string>& tokens, BuiltinContext& context)
+{
+    long debounceMs = 100;
+    vector<string> paths;
+    size_t i = 1;
+    for (; i < tokens.size() && tokens[i] != "--"; i++)
+    {
+        if (tokens[i] == "-d" && i + 1 < tokens.size())
+            debounceMs = atol(tokens[++i].c_str());
+        else
+            paths.push_back(tokens[i]);
+    }
+    if (paths.empty() || i + 1 >= tokens.size())
+    {
+        cerr << "on-change: usage: on-change [-d ms] PATH... -- command" << endl;
+        return false;
+    }
+    string command = join(vector<string>(tokens.begin() + i + 1, tokens.end()), " ");
+
+    WatchSet watches;
+    watches.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    bool ready = watches.fd >= 0 && timer >= 0;
+    if (!ready)
+        perror("on-change");
+    for (size_t p = 0; p < paths.size() && ready; p++)
+    {
+        struct stat info;
+        if (stat(paths[p].c_str(), &info) == 0 && S_ISDIR(info.st_mode))
+            watchTree(watches, paths[p]);
+        else
+            ready = watchFile(watches, paths[p]);
+    }
+    if (!ready)
+    {
+        if (timer >= 0)
+            close(timer);
+        if (watches.fd >= 0)
+            close(watches.fd);
+        return false;
+    }
+
+    catchInterrupt();
+    pid_t running = startRun(command, context);
+    int pidFd = running > 0 ? openPidFd(running) : -1;
+
+    while (!interrupted)
+    {
+        pollfd fds[3] = {{watches.fd, POLLIN, 0}, {timer, POLLIN, 0}, {pidFd, POLLIN, 0}};
+        // Without a pidfd, check on a running command every 50ms instead
+        int timeout = (running > 0 && pidFd < 0) ? 50 : -1;
+        if (poll(fds, 3, timeout) < 0 && errno != EINTR)
+            break;
+
+        siginfo_t exited = {};
+        if (running > 0 && pidFd < 0)
+            waitid(P_PID, running, &exited, WEXITED | WNOHANG | WNOWAIT);
+        if (running > 0 && (fds[2].revents != 0 || exited.si_pid == running))
+        {
+            finishRun(running);
+            running = -1;
+            if (pidFd >= 0)
+                close(pidFd);
+            pidFd = -1;
+        }
+
+        // Every relevant event pushes the deadline back, so a burst of writes is one rerun
+        if (fds[0].revents != 0 && readEvents(watches))
+        {
+            itimerspec due = {};
+            due.it_value.tv_sec = debounceMs / 1000;
+            due.it_value.tv_nsec = (debounceMs % 1000) * 1000000 + (debounceMs == 0 ? 1 : 0);
+            timerfd_settime(timer, 0, &due, nullptr);
+        }
+
+        uint64_t expirations;
+        if (fds[1].revents != 0 && read(timer, &expirations, sizeof(expirations)) > 0)
+        {
+            // Output from a run that is now stale is not worth waiting for
+            if (running > 0)
+            {
+                cancelRun(running);
+                if (pidFd >= 0)
+                    close(pidFd);
+            }
+            running = startRun(command, context);
+            pidFd = running > 0 ? openPidFd(running) : -1;
+        }
+    }
+
+    if (running > 0)
+        cancelRun(running);
+    if (pidFd >= 0)
+        close(pidFd);
+    close(timer);
+    close(watches.fd);
+    return true;
+}
+
+// Function to implement `watch [-n seconds] cmd`, rerunning cmd on a timerfd
+bool runWatch(vector<string>& tokens, BuiltinContext& context)
+{
+    double interval = 2;
+    size_t i = 1;
+    if (i + 1 < tokens.size() && tokens[i] == "-n")
+    {
+        interval = atof(tokens[i + 1].c_str());
+        i += 2;
+    }
+    if (i < tokens.size() && tokens[i] == "--")
+        i++;
+    if (interval < 0.1 || i >= tokens.size())
+    {
+        cerr << "watch: usage: watch [-n seconds] command (interval at least 0.1)" << endl;
+        return false;
+    }
+    string command = join(vector<string>(tokens.begin() + i, tokens.end()), " ");
+
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timer < 0)
+    {
+        perror("watch");
+        return false;
+    }
+    itimerspec period = {};
+    period.it_interval.tv_sec = (time_t)interval;
+    period.it_interval.tv_nsec = (long)((interval - (time_t)interval) * 1e9);
+    period.it_value.tv_nsec = 1; // First run right away
+    timerfd_settime(timer, 0, &period, nullptr);
+
+    bool terminal = isatty(STDOUT_FILENO);
+    catchInterrupt();
+    while (!interrupted)
+    {
+        // A run longer than the interval just merges the missed ticks into one
+        uint64_t expirations;
+        if (read(timer, &expirations, sizeof(expirations)) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (terminal)
+        {
+            time_t now = time(nullptr);
+            char stamp[64];
+            strftime(stamp, sizeof(stamp), "%c", localtime(&now));
+            cout << "\033[H\033[2J" << "Every " << interval << "s: " << command << "    " << stamp << "\n" << endl;
+        }
+        pid_t pid = startRun(command, context);
+        if (pid > 0)
+        {
+            // Ctrl-C lands in the poll below; the run is then cancelled, not waited for
+            int pidFd = openPidFd(pid);
+            while (pidFd >= 0 && !interrupted)
+            {
+                pollfd fd = {pidFd, POLLIN, 0};
+                if (poll(&fd, 1, -1) > 0)
+                    break;
+            }
+            if (pidFd >= 0)
+                close(pidFd);
+            if (interrupted)
+                cancelRun(pid);
+            else
+                finishRun(pid);
+        }
+    }
+    close(timer);
+    return true;
+}
@@ -0,0 +1,14 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "builtins.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Function declarations
+bool runOnChange(vector<string>& tokens, BuiltinContext& context);
+bool runWatch(vector<string>& tokens, BuiltinContext& context);
+
+#endif // WATCH_H
@@ -0,0 +1,312 @@
+#include "zygote.h"
+#include "vars.h"
+#include "limit.h"
+#include "pin.h"
+#include "arena.h"
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+using namespace std;
+
+extern char** environ;
+
+// The zygote is a small process forked at startup, before history, caches and indexes
+// have grown the shell. A fork costs time in proportion to the memory the parent maps,
+// so external commands are cloned from the zygote instead. The shell sends it each
+// command over a socketpair, with the fds to use attached (SCM_RIGHTS). The clone is
+// made with CLONE_PARENT, so it is the shell's own child and is waited for as usual
+
+// A request is this header, `limits` SpawnLimits, then argc + envc NUL-terminated strings.
+// Its fds are stdin, stdout, stderr and the working directory, in that order
+struct SpawnRequest
+{
+    int cpu;
+    int limits;
+    int argc;
+    int envc;
+};
+
+struct SpawnLimit
+{
+    int resource;
+    rlimit value;
+};
+
+static const size_t maxRequest = 64 * 1024; // A longer command takes the forked path
+static const int requestFds = 4;
+
+static int zygoteSocket = -1;
+static pid_t zygoteOwner = -1; // Children forked from the shell must not read its replies
+
+// Function run in the cloned child: take over the request's fds, directory, limits and CPU,
+// then exec. The clone skips glibc's fork handlers, which is safe as the zygote has one thread
+static void execRequest(const int* fds, const SpawnRequest& request, const vector<SpawnLimit>& limits, char** argv, char** envp)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        dup2(fds[i], i);
+    }
+    if (fchdir(fds[3]) != 0)
+        perror("zygote: cannot enter the working directory");
+    for (const SpawnLimit& limit : limits)
+    {
+        if (setrlimit(limit.resource, &limit.value) != 0)
+            perror("ulimit");
+    }
+    if (request.cpu >= 0)
+        pinToCpu(request.cpu);
+
+    // The zygote ignores these; the command gets them back as a child of the shell would
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTSTP, SIG_DFL);
+
+    // execvpe searches the PATH of the calling process, so it must be the shell's current one
+    environ = envp;
+    execvpe(argv[0], argv, envp);
+    int execErrno = errno;
+    perror("Error executing command");
+    _exit(execErrno == ENOENT ? 127 : 126);
+}
+
+// Function to check a request and start it; returns the new pid or -errno
+static int spawnRequest(const char* data, size_t length, const int* fds)
+{
+    SpawnRequest request;
+    if (length < sizeof(request))
+        return -EINVAL;
+    memcpy(&request, data, sizeof(request));
+    size_t offset = sizeof(request);
+    if (request.limits < 0 || request.argc < 1 || request.envc < 0 || (length - offset) / sizeof(SpawnLimit) < (size_t)request.limits)
+        return -EINVAL;
+
+    vector<SpawnLimit> limits(request.limits);
+    if (!limits.empty())
+        memcpy(limits.data(), data + offset, limits.size() * sizeof(SpawnLimit));
+    offset += limits.size() * sizeof(SpawnLimit);
+
+    // argv and envp point into the request; each string must end inside it
+    vector<char*> strings;
+    while (offset < length && strings.size() < (size_t)(request.argc + request.envc))
+    {
+        const char* end = static_cast<const char*>(memchr(data + offset, '\0', length - offset));
+        if (end == nullptr)
+            return -EINVAL;
+        strings.push_back(const_cast<char*>(data + offset));
+        offset = end - data + 1;
+    }
+    if (strings.size() != (size_t)(request.argc + request.envc))
+        return -EINVAL;
+    vector<char*> argv(strings.begin(), strings.begin() + request.argc);
+    vector<char*> envp(strings.begin() + request.argc, strings.end());
+    argv.push_back(nullptr);
+    envp.push_back(nullptr);
+
+    // glibc has no fork-like wrapper for clone; with no new stack the child resumes here
+    long pid = syscall(SYS_clone, CLONE_PARENT | SIGCHLD, 0, 0, 0, 0);
+    if (pid == 0)
+        execRequest(fds, request, limits, argv.data(), envp.data());
+    return pid < 0 ? -errno : pid;
+}
+
+// Function run by the zygote: serve spawn requests until the shell goes away
+static void serveRequests(int sock)
+{
+    // Ctrl-C and Ctrl-Z reach the shell's whole process group; they are for the shell's jobs
+    signal(SIGINT, SIG_IGN);
+    signal(SIGTSTP, SIG_IGN);
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+    // Hold no end of the shell's terminal or pipes: every command brings its own
+    int devNull = open("/dev/null", O_RDWR);
+    for (int fd = 0; fd < 3 && devNull >= 0; fd++)
+    {
+        if (fd != devNull)
+            dup2(devNull, fd);
+    }
+    if (devNull > 2)
+        close(devNull);
+
+    static char buffer[maxRequest];
+    while (true)
+    {
+        iovec iov = {buffer, sizeof(buffer)};
+        union
+        {
+            cmsghdr align;
+            char data[CMSG_SPACE(requestFds * sizeof(int))];
+        } control;
+        msghdr message = {};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control.data;
+        message.msg_controllen = sizeof(control.data);
+
+        // CLOEXEC so that no command keeps the fds meant for another
+        ssize_t length = recvmsg(sock, &message, MSG_CMSG_CLOEXEC);
+        if (length < 0 && errno == EINTR)
+            continue;
+        if (length <= 0)
+            _exit(0);
+
+        vector<int> fds;
+        for (cmsghdr* header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header))
+        {
+            if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+                continue;
+            size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const unsigned char* fdData = CMSG_DATA(header);
+            for (size_t i = 0; i < count; i++)
+            {
+                int fd;
+                memcpy(&fd, fdData + i * sizeof(int), sizeof(int));
+                fds.push_back(fd);
+            }
+        }
+
+        int reply = -EINVAL;
+        if (fds.size() == (size_t)requestFds && !(message.msg_flags & (MSG_TRUNC | MSG_CTRUNC)))
+            reply = spawnRequest(buffer, length, fds.data());
+        for (int fd : fds)
+        {
+            close(fd);
+        }
+        if (send(sock, &reply, sizeof(reply), MSG_NOSIGNAL) < 0)
+            _exit(0);
+    }
+}
+
+// Function to fork the zygote; call it early, while the shell is still small
+void startZygote()
+{
+    // Without a zygote every command is forked from the shell, as before
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sockets) != 0)
+        return;
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(sockets[0]);
+        close(sockets[1]);
+        return;
+    }
+    if (pid == 0)
+    {
+        close(sockets[0]);
+        serveRequests(sockets[1]);
+    }
+    close(sockets[1]);
+    zygoteSocket = sockets[0];
+    zygoteOwner = getpid();
+}
+
+// Function to check if this process can start commands through the zygote
+bool zygoteAvailable()
+{
+    return zygoteSocket >= 0 && getpid() == zygoteOwner;
+}
+
+// Function to start tokens as an external command from the zygote, reading inputFd and
+// writing outputFd (-1 keeps the shell's own) and pinned to cpu (-1 leaves it unpinned).
+// Returns the pid of the command, a child of the shell, or -1 if the zygote did not start it
+pid_t zygoteSpawn(const vector<string>& tokens, int inputFd, int outputFd, int cpu)
+{
+    if (!zygoteAvailable() || tokens.empty())
+        return -1;
+
+    char** envp = exportedEnvironment();
+    const map<int, rlimit>& limits = currentJobLimits();
+    SpawnRequest request = {cpu, (int)limits.size(), (int)tokens.size(), 0};
+    size_t length = sizeof(request) + limits.size() * sizeof(SpawnLimit);
+    for (const string& token : tokens)
+    {
+        length += token.size() + 1;
+    }
+    for (char** entry = envp; *entry != nullptr; entry++)
+    {
+        length += strlen(*entry) + 1;
+        request.envc++;
+    }
+    if (length > maxRequest)
+        return -1;
+
+    // Lay the request out in the line arena
+    ArenaScope scratch;
+    char* buffer = static_cast<char*>(lineArena().allocate(length));
+    char* out = buffer;
+    memcpy(out, &request, sizeof(request));
+    out += sizeof(request);
+    for (const auto& entry : limits)
+    {
+        SpawnLimit limit = {entry.first, entry.second};
+        memcpy(out, &limit, sizeof(limit));
+        out += sizeof(limit);
+    }
+    for (const string& token : tokens)
+    {
+        memcpy(out, token.c_str(), token.size() + 1);
+        out += token.size() + 1;
+    }
+    for (char** entry = envp; *entry != nullptr; entry++)
+    {
+        size_t size = strlen(*entry) + 1;
+        memcpy(out, *entry, size);
+        out += size;
+    }
+
+    int cwd = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (cwd < 0)
+        return -1;
+    int fds[requestFds] = {inputFd >= 0 ? inputFd : STDIN_FILENO, outputFd >= 0 ? outputFd : STDOUT_FILENO, STDERR_FILENO, cwd};
+
+    iovec iov = {buffer, length};
+    union
+    {
+        cmsghdr align;
+        char data[CMSG_SPACE(sizeof(fds))];
+    } control;
+    msghdr message = {};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.data;
+    message.msg_controllen = sizeof(control.data);
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+    ssize_t sent;
+    while ((sent = sendmsg(zygoteSocket, &message, MSG_NOSIGNAL)) < 0 && errno == EINTR)
+        ;
+    close(cwd);
+    int reply = -1;
+    ssize_t received = -1;
+    if (sent == (ssize_t)length)
+    {
+        while ((received = recv(zygoteSocket, &reply, sizeof(reply), 0)) < 0 && errno == EINTR)
+            ;
+    }
+    if (received != sizeof(reply))
+    {
+        // The zygote is gone; from now on commands are forked from the shell
+        close(zygoteSocket);
+        zygoteSocket = -1;
+        return -1;
+    }
+    if (reply < 0)
+    {
+        errno = -reply;
+        return -1;
+    }
+    return reply;
+}
@@ -0,0 +1,15 @@
+#ifndef ZYGOTE_H
+#define ZYGOTE_H
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+using namespace std;
+
+// Function declarations
+void startZygote();
+bool zygoteAvailable();
+pid_t zygoteSpawn(const vector<string>& tokens, int inputFd, int outputFd, int cpu);
+
+#endif // ZYGOTE_H